@@ -0,0 +1,105 @@
+import datetime
+import threading
+
+DAY_FORMAT = "%Y-%m-%d"
+HOUR_FORMAT = "%Y-%m-%dT%H"
+
+
+class AccessStats:
+    """Access counters kept up to date as events are logged, so reports never scan the log.
+
+    Counts are [granted, denied] pairs per card, per day, per hour and per hour of the day.
+    The top_size cards with the most accesses are kept ordered: counts only grow, so a card
+    can only enter the top by passing the last one and only moves up once in it, and every
+    event costs at most top_size steps whatever the size of the log.
+    """
+
+    def __init__(self, top_size: int = 100):
+        self.top_size = top_size
+        self.lock = threading.Lock()
+        self.totals = [0, 0]
+        self.cards = {}          # card number -> [granted, denied, last access]
+        self.days = {}           # "YYYY-mm-dd" -> [granted, denied]
+        self.hours = {}          # "YYYY-mm-ddTHH" -> [granted, denied]
+        self.hour_of_day = [[0, 0] for _ in range(24)]
+        self.top = []            # card numbers, most accesses first
+
+    def _count(self, card_number: str, result: int, day: str, hour: str, last: str):
+        column = 0 if result else 1
+        self.totals[column] += 1
+
+        counts = self.cards.get(card_number)
+        if counts is None:
+            counts = self.cards[card_number] = [0, 0, None]
+        counts[column] += 1
+        if counts[2] is None or last > counts[2]:     # events uploaded late are older
+            counts[2] = last
+
+        self.days.setdefault(day, [0, 0])[column] += 1
+        self.hours.setdefault(hour, [0, 0])[column] += 1
+        self.hour_of_day[int(hour[-2:])][column] += 1
+
+        self._rank(card_number, counts[0] + counts[1])
+
+    def _total(self, card_number: str) -> int:
+        counts = self.cards[card_number]
+        return counts[0] + counts[1]
+
+    def _rank(self, card_number: str, total: int):
+        top = self.top
+        if card_number in top:
+            i = top.index(card_number)
+        elif len(top) < self.top_size:
+            top.append(card_number)
+            i = len(top) - 1
+        elif total > self._total(top[-1]):
+            top[-1] = card_number
+            i = len(top) - 1
+        else:
+            return
+
+        while i > 0 and self._total(top[i - 1]) < total:
+            top[i - 1], top[i] = top[i], top[i - 1]
+            i -= 1
+
+    def add(self, card_number: str, result: int, when: datetime.datetime, reader: int = None):
+        # LogStore listener, called for every line appended
+        with self.lock:
+            self._count(card_number, result, when.strftime(DAY_FORMAT), when.strftime(HOUR_FORMAT),
+                        when.isoformat(sep=" ", timespec="seconds"))
+
+    def rebuild(self, entries):
+        """Counts (timestamp, granted, card number) tuples read back from the log, timestamps in
+        its "dd/mm/YYYY HH:MM:SS" format; sliced rather than parsed, a month of lines loads in seconds.
+        """
+        with self.lock:
+            for timestamp, granted, card_number in entries:
+                day = f"{timestamp[6:10]}-{timestamp[3:5]}-{timestamp[0:2]}"
+                self._count(card_number, granted, day, f"{day}T{timestamp[11:13]}", f"{day} {timestamp[11:]}")
+
+    def card(self, card_number: str):
+        with self.lock:
+            counts = self.cards.get(card_number)
+            if counts is None:
+                return {"card": card_number, "granted": 0, "denied": 0, "last_access": None}
+            return {"card": card_number, "granted": counts[0], "denied": counts[1], "last_access": counts[2]}
+
+    def summary(self, top: int = 10, days: int = 7, hours: int = 24, now: datetime.datetime = None):
+        """Totals, the busiest cards and the last days and hours, whatever the size of the log."""
+        now = now or datetime.datetime.now()
+        with self.lock:
+            day_keys = [(now - datetime.timedelta(days=i)).strftime(DAY_FORMAT) for i in range(days - 1, -1, -1)]
+            hour_keys = [(now - datetime.timedelta(hours=i)).strftime(HOUR_FORMAT) for i in range(hours - 1, -1, -1)]
+
+            return {
+                "granted": self.totals[0],
+                "denied": self.totals[1],
+                "cards": len(self.cards),
+                "top": [{"card": sn, "granted": self.cards[sn][0], "denied": self.cards[sn][1]}
+                        for sn in self.top[:max(0, min(top, self.top_size))]],
+                "days": [{"day": key, "granted": self.days.get(key, (0, 0))[0], "denied": self.days.get(key, (0, 0))[1]}
+                         for key in day_keys],
+                "hours": [{"hour": key, "granted": self.hours.get(key, (0, 0))[0], "denied": self.hours.get(key, (0, 0))[1]}
+                          for key in hour_keys],
+                "hour_of_day": [{"hour": h, "granted": g, "denied": d} for h, (g, d) in enumerate(self.hour_of_day)],
+            }
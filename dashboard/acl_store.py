@@ -0,0 +1,167 @@
+import os
+import threading
+from collections import deque
+
+
+class AclStore:
+    """Access list kept in memory as a set, persisted as a snapshot file plus a write-ahead log.
+
+    The snapshot (ACCESS) has one serial number per line. Every change is first appended to
+    the log (ACCESS.wal) as "+sn" or "-sn" and then applied to the set, so lookups never touch
+    the disk. Once the log grows past compact_after entries the snapshot is rewritten to a
+    temporary file and swapped in with os.replace, and the log is truncated. Replaying the log
+    over a snapshot that already contains it gives the same set, so a crash at any point
+    leaves a consistent list.
+
+    Every change also bumps the list version, so readers can ask for the changes since the
+    version they have (changes_since). The version of the snapshot is kept in ACCESS.version
+    and each log entry adds one; the last history_size changes are kept in memory, rebuilt
+    from the log at startup, and readers further behind get the whole list instead.
+    """
+
+    def __init__(self, path: str = "ACCESS", compact_after: int = 1000, history_size: int = 4096):
+        self.path = path
+        self.wal_path = path + ".wal"
+        self.version_path = path + ".version"
+        self.compact_after = compact_after
+        self.lock = threading.Lock()
+        self.cards = set()
+        self.wal_entries = 0
+        self.text = None
+        self.version = 0
+        self.history = deque(maxlen=history_size)   # (version, op, card number), oldest first
+
+        self._load()
+
+    def _load(self):
+        if os.path.exists(self.path):
+            with open(self.path, "r") as f:
+                self.cards = {line.strip() for line in f if line.strip()}
+
+        if os.path.exists(self.version_path):
+            with open(self.version_path, "r") as f:
+                self.version = int(f.read().strip() or 0)
+
+        torn = False
+        if os.path.exists(self.wal_path):
+            with open(self.wal_path, "r") as f:
+                for line in f:
+                    if not line.endswith("\n"):
+                        # last write interrupted, it was never acknowledged
+                        torn = True
+                        break
+                    self._apply(line[0], line[1:].strip())
+                    self._record(line[0], line[1:].strip())
+                    self.wal_entries += 1
+
+        if torn or self.wal_entries > 0:
+            self.compact()
+
+    def _apply(self, op: str, card_number: str):
+        if not card_number:
+            return
+        if op == "+":
+            self.cards.add(card_number)
+        elif op == "-":
+            self.cards.discard(card_number)
+
+    def _record(self, op: str, card_number: str):
+        self.version += 1
+        self.history.append((self.version, op, card_number))
+
+    def contains(self, card_number: str) -> bool:
+        # set lookups are atomic, readers do not need the lock
+        return card_number in self.cards
+
+    def __len__(self):
+        return len(self.cards)
+
+    def add(self, card_numbers) -> int:
+        return self._update("+", card_numbers)
+
+    def remove(self, card_numbers) -> int:
+        return self._update("-", card_numbers)
+
+    def _update(self, op: str, card_numbers) -> int:
+        with self.lock:
+            if op == "+":
+                changes = {sn.strip() for sn in card_numbers if sn.strip() and sn.strip() not in self.cards}
+            else:
+                changes = {sn.strip() for sn in card_numbers if sn.strip() in self.cards}
+
+            if not changes:
+                return 0
+
+            with open(self.wal_path, "a") as f:
+                f.writelines(f"{op}{sn}\n" for sn in changes)
+                f.flush()
+                os.fsync(f.fileno())
+
+            for sn in changes:
+                self._apply(op, sn)
+                self._record(op, sn)
+            self.wal_entries += len(changes)
+            self.text = None
+
+            if self.wal_entries >= self.compact_after:
+                self._compact()
+
+            return len(changes)
+
+    def compact(self):
+        with self.lock:
+            self._compact()
+
+    def _compact(self):
+        tmp_path = self.path + ".tmp"
+        with open(tmp_path, "w") as f:
+            f.writelines(sn + "\n" for sn in self.cards)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp_path, self.path)
+
+        # a crash before the log is truncated replays it over this version, which only
+        # moves the version further ahead and sends the readers a snapshot
+        with open(self.version_path + ".tmp", "w") as f:
+            f.write(f"{self.version}\n")
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(self.version_path + ".tmp", self.version_path)
+
+        # the snapshot now holds every change, the log can start over
+        with open(self.wal_path, "w") as f:
+            f.flush()
+            os.fsync(f.fileno())
+        self.wal_entries = 0
+
+    def changes_since(self, version: int):
+        """(current version, {card number: "+" or "-"}) of the changes after version.
+
+        The changes are None when they are not all in the history anymore (or the version is
+        unknown, e.g. 0 or ahead of ours) or outnumber the list, the reader needs a snapshot.
+        """
+        with self.lock:
+            current = self.version
+            if version == current and version > 0:
+                return current, {}
+            oldest = self.history[0][0] if self.history else current + 1
+            if version <= 0 or version > current or version + 1 < oldest:
+                return current, None
+
+            # only the last change of each card matters
+            changes = {}
+            for entry_version, op, sn in reversed(self.history):
+                if entry_version <= version:
+                    break
+                changes.setdefault(sn, op)
+
+            return current, changes if len(changes) <= len(self.cards) else None
+
+    def snapshot(self) -> str:
+        # one serial number per line, rebuilt only after a change
+        text = self.text
+        if text is None:
+            with self.lock:
+                text = "".join(sn + "\n" for sn in self.cards)
+                self.text = text
+        return text
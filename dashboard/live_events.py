@@ -0,0 +1,115 @@
+import asyncio
+import secrets
+import threading
+from collections import deque
+
+from log_store import format_line
+
+HEARTBEAT_S = 15
+
+
+class LiveEvents:
+    """Pushes every line logged to the browsers connected to /events (Server-Sent Events).
+
+    Lines are numbered as they are logged and the last backlog of them are kept, so a page
+    rendered up to line N subscribes with after=N (or Last-Event-ID when EventSource
+    reconnects) and gets exactly the lines it is missing. Ids are "epoch-N", the epoch being
+    drawn at startup: numbering starts over with the server, and a page that reconnects with
+    the id of an earlier run is reset instead of skipping the first N lines of this one. A
+    client too far behind, or one whose queue fills up because it does not read, is sent a
+    reset event and dropped; the page reloads once instead of the server buffering for it.
+    """
+
+    def __init__(self, backlog: int = 256, client_queue: int = 256):
+        self.client_queue = client_queue
+        self.lock = threading.Lock()
+        self.epoch = secrets.token_hex(4)
+        self.last_id = 0
+        self.recent = deque(maxlen=backlog)     # (id, line), oldest first
+        self.clients = set()
+        self.loop = None
+
+    def position(self) -> str:
+        """Id of the last line logged, where a page rendered now continues from."""
+        return f"{self.epoch}-{self.last_id}"
+
+    def _parse(self, event_id: str):
+        # line number of an id of this run, None otherwise
+        epoch, _, number = (event_id or "").partition("-")
+        return int(number) if epoch == self.epoch and number.isdigit() else None
+
+    def attach(self, loop: asyncio.AbstractEventLoop):
+        # the loop the streams run on, lines are handed over to it
+        self.loop = loop
+
+    def add(self, card_number: str, result: int, when, reader: int = None):
+        # LogStore listener, called on the log writer thread while the store is locked, so
+        # last_id always matches what a query of the store returns
+        line = format_line(card_number, result, when, reader).rstrip("\n")
+        # clients are registered under the same lock as they read the backlog, a line is either
+        # in the backlog they read or published to them
+        with self.lock:
+            self.last_id += 1
+            event = (self.last_id, line)
+            self.recent.append(event)
+            clients = list(self.clients)
+
+        if self.loop is not None and clients:
+            self.loop.call_soon_threadsafe(self._publish, event, clients)
+
+    def _publish(self, event, clients):
+        for queue in clients:
+            try:
+                queue.put_nowait(event)
+            except asyncio.QueueFull:
+                with self.lock:
+                    self.clients.discard(queue)
+                queue.get_nowait()
+                queue.put_nowait(None)
+
+    async def stream(self, after_id: str):
+        """Lines logged after the one with id after_id, as SSE messages, until the client leaves."""
+        queue = asyncio.Queue(self.client_queue)
+
+        after = self._parse(after_id)
+        if after is None:
+            yield "event: reset\ndata: \n\n"
+            return
+
+        with self.lock:
+            missed = [event for event in self.recent if event[0] > after]
+            # lines between after and the backlog are gone
+            lost = after > self.last_id or (missed and missed[0][0] > after + 1) or \
+                (not missed and after < self.last_id)
+            # lines logged from now on are published to the queue, the ones before are in missed
+            if not lost:
+                self.clients.add(queue)
+        if lost:
+            yield "event: reset\ndata: \n\n"
+            return
+
+        try:
+            sent = after
+            for event_id, line in missed:
+                yield f"id: {self.epoch}-{event_id}\ndata: {line}\n\n"
+                sent = event_id
+
+            while True:
+                try:
+                    event = await asyncio.wait_for(queue.get(), HEARTBEAT_S)
+                except asyncio.TimeoutError:
+                    yield ": ping\n\n"
+                    continue
+
+                if event is None:
+                    yield "event: reset\ndata: \n\n"
+                    return
+                if event[0] > sent:
+                    yield f"id: {self.epoch}-{event[0]}\ndata: {event[1]}\n\n"
+                    sent = event[0]
+        finally:
+            with self.lock:
+                self.clients.discard(queue)
+
+    def __len__(self):
+        return len(self.clients)
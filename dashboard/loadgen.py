@@ -0,0 +1,205 @@
+"""Simulated reader fleet for benchmarking the dashboard on localhost.
+
+Every reader is a thread with its own keep-alive connection, like the firmware, sending
+scans at a fixed rate. Latency is measured from the time each scan was due, so a server
+that falls behind shows up in the percentiles instead of silently lowering the rate.
+After the run the log is read back through /logs to check that every decision was
+written once and no line was torn by concurrent writers.
+
+    python3 main.py                                  # with SERVER_IP=127.0.0.1, from a scratch copy
+    python3 loadgen.py --readers 20 --rate 5 --duration 30
+    python3 loadgen.py --source LOGFILE --protocol udp
+"""
+
+import argparse
+import datetime
+import http.client
+import json
+import random
+import re
+import socket
+import struct
+import threading
+import time
+
+LINE_RE = re.compile(r"^\[\d{2}/\d{2}/\d{4} \d{2}:\d{2}:\d{2}\] : Access (granted|denied) "
+                     r"\(card number ([^,\s)]+)(?:, reader (\d+))?\)$")
+FRAME = struct.Struct("<BBBBIQ")
+
+
+def synthetic_cards(count: int, seed: int):
+    rng = random.Random(seed)
+    return [str(rng.randrange(10 ** 11, 10 ** 13)) for _ in range(count)]
+
+
+def logfile_cards(path: str):
+    with open(path, "r") as f:
+        cards = [match.group(2) for match in map(LINE_RE.match, (line.rstrip("\n") for line in f)) if match]
+    if not cards:
+        raise SystemExit(f"no access lines in {path}")
+    return cards
+
+
+class HttpReader:
+    def __init__(self, host: str, port: int, timeout: float, reader_id: int):
+        self.connection = http.client.HTTPConnection(host, port, timeout=timeout)
+        self.reader_id = reader_id
+
+    def check(self, card_number: str):
+        body = json.dumps({"sn": card_number, "reader": self.reader_id})
+        try:
+            self.connection.request("POST", "/check_access", body, {"Content-Type": "application/json"})
+            response = self.connection.getresponse()
+            data = response.read()
+        except (OSError, http.client.HTTPException) as e:
+            self.connection.close()
+            return type(e).__name__
+        if response.status != 200:
+            return f"HTTP {response.status}"
+        return None if data.strip() in (b"0", b"1") else "bad body"
+
+    def close(self):
+        self.connection.close()
+
+
+class UdpReader:
+    def __init__(self, host: str, port: int, timeout: float, reader_id: int):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.connect((host, port))
+        self.sock.settimeout(timeout)
+        self.reader_id = reader_id & 0xFF
+        self.sequence = 0
+
+    def check(self, card_number: str):
+        self.sequence += 1
+        self.sock.send(FRAME.pack(0xA5, 1, 0, self.reader_id, self.sequence, int(card_number)))
+        try:
+            while True:
+                magic, kind, _, _, sequence, _ = FRAME.unpack(self.sock.recv(64)[:FRAME.size])
+                if magic == 0xA5 and kind == 2 and sequence == self.sequence:
+                    return None
+        except socket.timeout:
+            return "timeout"
+        except (OSError, struct.error) as e:
+            return type(e).__name__
+
+    def close(self):
+        self.sock.close()
+
+
+def run_reader(reader, cards, rate: float, deadline: float, results: list):
+    interval = 1.0 / rate
+    due = time.perf_counter() + random.random() * interval   # readers do not scan in lockstep
+    index = 0
+    while due < deadline:
+        now = time.perf_counter()
+        if now < due:
+            time.sleep(due - now)
+
+        error = reader.check(cards[index % len(cards)])
+        results.append((time.perf_counter() - due, error, cards[index % len(cards)]))
+
+        index += 1
+        due += interval
+    reader.close()
+
+
+def percentile(values, p: float):
+    if not values:
+        return float("nan")
+    return values[min(len(values) - 1, int(round(p / 100 * (len(values) - 1))))]
+
+
+def check_log(host: str, port: int, since: datetime.datetime, sent: dict):
+    # pages of /logs newer than the start of the run, compared with what was sent
+    connection = http.client.HTTPConnection(host, port, timeout=10)
+    logged, torn, page = {}, 0, 0
+    while True:
+        connection.request("GET", f"/logs?page={page}&size=500&since={since.isoformat(timespec='seconds')}")
+        data = json.loads(connection.getresponse().read())
+        for line in data["logs"]:
+            match = LINE_RE.match(line)
+            if match is None:
+                torn += 1
+            else:
+                logged[match.group(2)] = logged.get(match.group(2), 0) + 1
+        if not data["has_next"]:
+            break
+        page += 1
+    connection.close()
+
+    missing = sum(max(0, count - logged.get(card, 0)) for card, count in sent.items())
+    extra = sum(max(0, count - sent.get(card, 0)) for card, count in logged.items())
+    return sum(logged.values()), missing, extra, torn
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulated reader fleet for the dashboard")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--udp-port", type=int, default=4210)
+    parser.add_argument("--protocol", choices=("http", "udp"), default="http")
+    parser.add_argument("--readers", type=int, default=10)
+    parser.add_argument("--rate", type=float, default=2.0, help="scans per second per reader")
+    parser.add_argument("--duration", type=float, default=20.0, help="seconds")
+    parser.add_argument("--timeout", type=float, default=1.5, help="seconds, the firmware gives up after 1.5 s")
+    parser.add_argument("--source", default=None, help="LOGFILE to replay the card numbers of, synthetic if omitted")
+    parser.add_argument("--cards", type=int, default=1000, help="distinct synthetic cards")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--no-log-check", action="store_true")
+    args = parser.parse_args()
+
+    cards = logfile_cards(args.source) if args.source else synthetic_cards(args.cards, args.seed)
+
+    # the log check filters on whole seconds
+    start_time = datetime.datetime.now().replace(microsecond=0)
+    time.sleep(1.0 - datetime.datetime.now().microsecond / 1e6)
+
+    threads, results = [], []
+    start = time.perf_counter()
+    deadline = start + args.duration
+    for i in range(args.readers):
+        if args.protocol == "http":
+            reader = HttpReader(args.host, args.port, args.timeout, i + 1)
+        else:
+            reader = UdpReader(args.host, args.udp_port, args.timeout, i + 1)
+        # every reader walks the stream from a different point
+        offset = i * len(cards) // args.readers
+        per_reader = []
+        results.append(per_reader)
+        threads.append(threading.Thread(target=run_reader,
+                                        args=(reader, cards[offset:] + cards[:offset], args.rate, deadline, per_reader)))
+
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.perf_counter() - start
+
+    samples = [sample for per_reader in results for sample in per_reader]
+    latencies = sorted(latency for latency, error, _ in samples if error is None)
+    errors = {}
+    for _, error, _ in samples:
+        if error is not None:
+            errors[error] = errors.get(error, 0) + 1
+
+    offered = args.readers * args.rate
+    print(f"{args.readers} readers x {args.rate:g} scans/s over {args.protocol}, {elapsed:.1f} s")
+    print(f"sent       {len(samples)} ({len(samples) / elapsed:.1f}/s, offered {offered:.1f}/s)")
+    print(f"answered   {len(latencies)} ({len(latencies) / elapsed:.1f}/s)")
+    print(f"errors     {len(samples) - len(latencies)} ({(len(samples) - len(latencies)) / max(1, len(samples)):.2%})"
+          + "".join(f", {name}: {count}" for name, count in sorted(errors.items())))
+    print("latency    p50 {:.2f} ms, p95 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms".format(
+        *(percentile(latencies, p) * 1e3 for p in (50, 95, 99, 100))))
+
+    if not args.no_log_check:
+        sent = {}
+        for _, error, card in samples:
+            if error is None:
+                sent[card] = sent.get(card, 0) + 1
+        total, missing, extra, torn = check_log(args.host, args.port, start_time, sent)
+        print(f"log        {total} lines since {start_time:%H:%M:%S}, {missing} missing, {extra} unexpected, {torn} malformed")
+
+
+if __name__ == "__main__":
+    main()
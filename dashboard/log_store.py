@@ -0,0 +1,644 @@
+import array
+import bisect
+import datetime
+import gzip
+import itertools
+import json
+import os
+import queue
+import re
+import threading
+import time
+import zlib
+from collections import OrderedDict, deque
+
+TIME_FORMAT = "%d/%m/%Y %H:%M:%S"
+# the reader suffix is only there for readers that send their id
+LINE_RE = re.compile(r"^\[(\d{2}/\d{2}/\d{4} \d{2}:\d{2}:\d{2})\] : Access (granted|denied) "
+                     r"\(card number ([^,\s)]+)(?:, reader (\d+))?\)$")
+SEGMENT_RE = re.compile(r"^segment-(\d{6})\.log(\.gz)?$")
+BLOCK_LINES = 256
+
+
+def format_line(card_number: str, result: int, when: datetime.datetime = None, reader: int = None) -> str:
+    access = "granted" if result else "denied"
+    timestamp = (when or datetime.datetime.now()).strftime(TIME_FORMAT)
+    suffix = f", reader {reader}" if reader is not None else ""
+
+    return f"[{timestamp}] : Access {access} (card number {card_number}{suffix})\n"
+
+
+def parse_line(line: str):
+    # (timestamp, card number) of a log line, None if it is not one
+    match = LINE_RE.match(line.rstrip("\n"))
+    if match is None:
+        return None
+
+    when = datetime.datetime.strptime(match.group(1), TIME_FORMAT)
+    return when.timestamp(), match.group(3)
+
+
+class Segment:
+    def __init__(self, seg_id: int, path: str, sealed: bool):
+        self.id = seg_id
+        self.path = path
+        self.sealed = sealed
+        self.lines = 0
+        self.loaded = not sealed            # timestamps and cards of a sealed segment are read on demand
+        self.timestamps = array.array("d")
+        self.cards = {}                     # card number -> array of the segment's line numbers it is on
+        self.card_lines = {}                # card number -> how many lines it has, always in memory
+        self.offsets = array.array("Q")     # byte offset of each line, only while the segment is active
+        self.blocks = []                    # file offset of each gzip member, once sealed
+        self.min_ts = float("inf")
+        self.max_ts = float("-inf")
+
+    def __len__(self):
+        return self.lines
+
+    def add(self, ts: float, card_number: str, offset: int = 0):
+        self.timestamps.append(ts)
+        self.cards.setdefault(card_number, array.array("I")).append(self.lines)
+        self.card_lines[card_number] = self.card_lines.get(card_number, 0) + 1
+        if not self.sealed:
+            self.offsets.append(offset)
+        self.lines += 1
+        self.min_ts = min(self.min_ts, ts)
+        self.max_ts = max(self.max_ts, ts)
+
+    def card_of_lines(self):
+        cards = [None] * self.lines
+        for card_number, lines in self.cards.items():
+            for line in lines:
+                cards[line] = card_number
+        return cards
+
+    def unload(self):
+        self.loaded = False
+        self.timestamps = array.array("d")
+        self.cards = {}
+
+    def overlaps(self, since: float, until: float) -> bool:
+        return self.max_ts >= since and self.min_ts <= until
+
+    def within(self, since: float, until: float) -> bool:
+        return since <= self.min_ts and self.max_ts <= until
+
+
+class LogStore:
+    """Access log split in segments of segment_lines lines, newest last.
+
+    The active segment is a plain text file in the LOGFILE format. When it is full it is
+    gzipped, one gzip member per BLOCK_LINES lines so a single line can be read without
+    inflating the whole segment (zcat still reads it as one file), and a sidecar index
+    (segment-N.idx) is written next to it, so sealed segments are never parsed again. The
+    first line of the index holds the line count, time range, member offsets and lines per
+    card and is all that is read at startup; the second holds the timestamp and card number of
+    each line and is only loaded when a query has to look inside the segment (cached_indexes of
+    them are kept). Lines are addressed by a global line number. A query skips whole segments
+    by their counts (every line, or every line of the card, when the segment is inside the time
+    range), so a deep page costs about the same as the first one. Timestamps are not assumed to be
+    ordered, events uploaded late by a reader carry the time they happened. With max_segments,
+    only that many sealed segments are kept, the oldest are deleted as new ones are sealed.
+    """
+
+    def __init__(self, directory: str = "logs", segment_lines: int = 10000, legacy_file: str = "LOGFILE",
+                 cached_blocks: int = 64, cached_indexes: int = 16, max_segments: int = 0):
+        self.directory = directory
+        self.segment_lines = segment_lines
+        self.cached_blocks = cached_blocks
+        self.cached_indexes = cached_indexes
+        self.max_segments = max_segments
+        self.lock = threading.RLock()
+        self.segments = []          # oldest first
+        self.starts = []            # global line number of the first line of each segment
+        self.count = 0              # global line numbers handed out, deleted segments included
+        self.active = None
+        self.active_file = None
+        self.read_file = None       # the active segment opened for reading, kept open
+        self.pending = []           # encoded lines of the active segment not written yet
+        self.pending_size = 0
+        self.cache = OrderedDict()  # (sealed segment id, block) -> its lines
+        self.indexes = OrderedDict()  # sealed segment id -> segment whose index is loaded
+        self.listeners = []         # called with (card number, result, when, reader) for every append
+
+        os.makedirs(directory, exist_ok=True)
+        self._load()
+
+        if self.count == 0 and legacy_file and os.path.exists(legacy_file):
+            self._import(legacy_file)
+
+    # --- loading ---
+
+    def _path(self, seg_id: int, suffix: str) -> str:
+        return os.path.join(self.directory, f"segment-{seg_id:06d}{suffix}")
+
+    def _load(self):
+        for name in os.listdir(self.directory):
+            if name.endswith(".tmp"):
+                os.remove(os.path.join(self.directory, name))
+
+        plain, sealed = set(), set()
+        for name in os.listdir(self.directory):
+            match = SEGMENT_RE.match(name)
+            if match:
+                (sealed if match.group(2) else plain).add(int(match.group(1)))
+
+        # a segment that was sealed but not removed yet
+        for seg_id in plain & sealed:
+            os.remove(self._path(seg_id, ".log"))
+        plain -= sealed
+
+        for seg_id in sorted(sealed):
+            self._load_sealed(seg_id)
+
+        # only the newest plain segment can still be written to, older ones are sealed now
+        for seg_id in sorted(plain):
+            self._load_active(seg_id)
+            if seg_id != max(plain):
+                self._seal()
+
+        self._expire()
+
+    def _add_segment(self, segment: Segment):
+        self.segments.append(segment)
+        self.starts.append(self.count)
+
+    def _open_active(self, segment: Segment):
+        self.active = segment
+        self.active_file = open(segment.path, "ab")
+        self.read_file = open(segment.path, "rb")
+
+    def _load_sealed(self, seg_id: int):
+        segment = Segment(seg_id, self._path(seg_id, ".log.gz"), sealed=True)
+
+        idx_path = self._path(seg_id, ".idx")
+        if not os.path.exists(idx_path):
+            # index lost, compress the segment again to rebuild it
+            with gzip.open(segment.path, "rb") as f:
+                lines = [line for line in f if parse_line(line.decode(errors="replace")) is not None]
+            entries = [parse_line(line.decode(errors="replace")) for line in lines]
+            self._write_sealed(seg_id, lines, [ts for ts, _ in entries], [card for _, card in entries])
+
+        with open(idx_path, "r") as f:
+            header = json.loads(f.readline())
+            if "timestamps" in header:
+                # index written before it had a header, rewritten once
+                self._write_index(seg_id, header["timestamps"], header["cards"], header["blocks"])
+                header = self._index_header(header["timestamps"], header["cards"], header["blocks"])
+
+        segment.lines = header["lines"]
+        segment.min_ts = header["min_ts"] if segment.lines else float("inf")
+        segment.max_ts = header["max_ts"] if segment.lines else float("-inf")
+        segment.blocks = header["blocks"]
+        segment.card_lines = header["card_lines"]
+
+        self._add_segment(segment)
+        self.count += segment.lines
+
+    def _load_index(self, segment: Segment) -> Segment:
+        # timestamps and card numbers of a sealed segment, the least recently used are dropped
+        if segment.loaded:
+            if segment.sealed:
+                self.indexes.move_to_end(segment.id)
+            return segment
+
+        with open(self._path(segment.id, ".idx"), "r") as f:
+            f.readline()
+            index = json.loads(f.readline())
+        for ts, card_number in zip(index["timestamps"], index["cards"]):
+            segment.timestamps.append(ts)
+            segment.cards.setdefault(card_number, array.array("I")).append(len(segment.timestamps) - 1)
+        segment.loaded = True
+
+        self.indexes[segment.id] = segment
+        if len(self.indexes) > self.cached_indexes:
+            self.indexes.popitem(last=False)[1].unload()
+        return segment
+
+    def _load_active(self, seg_id: int):
+        segment = Segment(seg_id, self._path(seg_id, ".log"), sealed=False)
+        self._add_segment(segment)
+
+        with open(segment.path, "rb") as f:
+            valid = 0
+            for raw in iter(f.readline, b""):
+                entry = parse_line(raw.decode(errors="replace")) if raw.endswith(b"\n") else None
+                if entry is not None:
+                    segment.add(entry[0], entry[1], valid)
+                    self.count += 1
+                valid = f.tell() if raw.endswith(b"\n") else valid
+
+        # drop a line torn by a crash so the next append starts on a fresh line
+        if os.path.getsize(segment.path) != valid:
+            os.truncate(segment.path, valid)
+
+        self._open_active(segment)
+
+    def _import(self, legacy_file: str):
+        with open(legacy_file, "r") as f:
+            for line in f:
+                entry = parse_line(line)
+                if entry is not None:
+                    self._append(line if line.endswith("\n") else line + "\n", entry[0], entry[1])
+        if self.active_file is not None:
+            self._write_pending()
+
+    # --- writing ---
+
+    @staticmethod
+    def _index_header(timestamps, cards, blocks):
+        card_lines = {}
+        for card_number in cards:
+            card_lines[card_number] = card_lines.get(card_number, 0) + 1
+        return {"lines": len(timestamps), "min_ts": min(timestamps, default=0), "max_ts": max(timestamps, default=0),
+                "blocks": blocks, "card_lines": card_lines}
+
+    def _write_index(self, seg_id: int, timestamps, cards, blocks):
+        tmp_path = self._path(seg_id, ".idx.tmp")
+        with open(tmp_path, "w") as f:
+            f.write(json.dumps(self._index_header(timestamps, cards, blocks)) + "\n")
+            f.write(json.dumps({"timestamps": list(timestamps), "cards": cards}) + "\n")
+        os.replace(tmp_path, self._path(seg_id, ".idx"))
+
+    def _write_sealed(self, seg_id: int, lines, timestamps, cards):
+        gz_path = self._path(seg_id, ".log.gz")
+
+        blocks = []
+        with open(gz_path + ".tmp", "wb") as f:
+            for first in range(0, len(lines), BLOCK_LINES):
+                blocks.append(f.tell())
+                f.write(gzip.compress(b"".join(lines[first:first + BLOCK_LINES])))
+
+        self._write_index(seg_id, timestamps, cards, blocks)
+
+        # the gzip only appears once its index is there, the plain file goes last
+        os.replace(gz_path + ".tmp", gz_path)
+        return gz_path, blocks
+
+    def _seal(self):
+        segment = self.active
+        self._write_pending()
+        self.active_file.close()
+        self.read_file.close()
+        self.active = self.active_file = self.read_file = None
+
+        # only the indexed lines are kept, so line numbers match the index
+        with open(segment.path, "rb") as f:
+            content = f.read()
+        lines = [content[offset:content.index(b"\n", offset) + 1] for offset in segment.offsets]
+
+        gz_path, blocks = self._write_sealed(segment.id, lines, segment.timestamps, segment.card_of_lines())
+        os.remove(segment.path)
+
+        segment.path = gz_path
+        segment.sealed = True
+        segment.blocks = blocks
+        segment.offsets = array.array("Q")
+
+        # its index is still in memory, it counts as loaded
+        self.indexes[segment.id] = segment
+        if len(self.indexes) > self.cached_indexes:
+            self.indexes.popitem(last=False)[1].unload()
+        self._expire()
+
+    def _expire(self):
+        # oldest sealed segments beyond max_segments, line numbers of the others do not change
+        if self.max_segments <= 0:
+            return
+        sealed = sum(1 for segment in self.segments if segment.sealed)
+        while sealed > self.max_segments:
+            segment = self.segments.pop(0)
+            self.starts.pop(0)
+            self.indexes.pop(segment.id, None)
+            for key in [key for key in self.cache if key[0] == segment.id]:
+                del self.cache[key]
+            os.remove(self._path(segment.id, ".idx"))
+            os.remove(segment.path)
+            sealed -= 1
+
+    def _append(self, line: str, ts: float, card_number: str):
+        if self.active is not None and len(self.active) >= self.segment_lines:
+            self._seal()
+
+        if self.active is None:
+            seg_id = self.segments[-1].id + 1 if self.segments else 1
+            segment = Segment(seg_id, self._path(seg_id, ".log"), sealed=False)
+            self._add_segment(segment)
+            self._open_active(segment)
+
+        data = line.encode()
+        offset = self.active_file.tell() + self.pending_size
+        self.pending.append(data)
+        self.pending_size += len(data)
+        self.active.add(ts, card_number, offset)
+        self.count += 1
+
+    def _write_pending(self):
+        # the lines appended since the last call in a single write
+        if self.pending:
+            self.active_file.write(b"".join(self.pending))
+            self.pending = []
+            self.pending_size = 0
+        self.active_file.flush()
+
+    def append(self, card_number: str, result: int, when: datetime.datetime = None, reader: int = None):
+        self.append_many([(card_number, result, when, reader)])
+
+    def append_many(self, events):
+        # events are (card number, result, when, reader) tuples, when may be None for now and reader
+        # None when the reader did not send its id
+        with self.lock:
+            for card_number, result, when, reader in events:
+                when = when or datetime.datetime.now()
+                self._append(format_line(card_number, result, when, reader), when.timestamp(), card_number)
+                for listener in self.listeners:
+                    listener(card_number, result, when, reader)
+            self._write_pending()
+
+    def sync(self):
+        """Forces the active segment to disk, sealed segments are already closed.
+
+        The fsync runs on a duplicate of the descriptor, outside the lock: appends and queries
+        are not held up by the disk.
+        """
+        with self.lock:
+            if self.active_file is None:
+                return
+            self.active_file.flush()
+            fd = os.dup(self.active_file.fileno())
+        try:
+            os.fsync(fd)
+        finally:
+            os.close(fd)
+
+    def subscribe(self, listener):
+        self.listeners.append(listener)
+
+    # --- reading ---
+
+    def _segment_of(self, line: int) -> int:
+        return bisect.bisect_right(self.starts, line) - 1
+
+    def _sealed_line(self, segment: Segment, local: int) -> str:
+        block = local // BLOCK_LINES
+        key = (segment.id, block)
+
+        lines = self.cache.get(key)
+        if lines is None:
+            with open(segment.path, "rb") as f:
+                f.seek(segment.blocks[block])
+                end = segment.blocks[block + 1] if block + 1 < len(segment.blocks) else None
+                data = f.read(end - segment.blocks[block]) if end is not None else f.read()
+            lines = [line.decode(errors="replace") for line in zlib.decompress(data, wbits=31).splitlines(keepends=True)]
+            self.cache[key] = lines
+            if len(self.cache) > self.cached_blocks:
+                self.cache.popitem(last=False)
+        else:
+            self.cache.move_to_end(key)
+
+        return lines[local % BLOCK_LINES]
+
+    def _read(self, lines):
+        result = []
+        for line in lines:
+            i = self._segment_of(line)
+            segment = self.segments[i]
+            local = line - self.starts[i]
+            if segment.sealed:
+                result.append(self._sealed_line(segment, local))
+            else:
+                self.read_file.seek(segment.offsets[local])
+                result.append(self.read_file.readline().decode(errors="replace"))
+        return result
+
+    def _newest_first(self, card_number, since: float, until: float, skip: int):
+        # global line numbers newest first, after the first skip matches. A segment inside the
+        # time range is skipped by its count (of the card's lines, for a card) without being read.
+        ranged = since != float("-inf") or until != float("inf")
+
+        for i in range(len(self.segments) - 1, -1, -1):
+            segment = self.segments[i]
+            start = self.starts[i]
+            if ranged and not segment.overlaps(since, until):
+                continue
+            whole = not ranged or segment.within(since, until)
+
+            if card_number is not None and whole and skip >= segment.card_lines.get(card_number, 0):
+                skip -= segment.card_lines.get(card_number, 0)
+                continue
+            if card_number is not None and card_number not in segment.card_lines:
+                continue
+
+            if card_number is None and whole:
+                locals_ = range(len(segment))
+            else:
+                index = self._load_index(segment)
+                locals_ = index.cards.get(card_number, ()) if card_number is not None else range(len(segment))
+
+            if whole:
+                if skip >= len(locals_):
+                    skip -= len(locals_)
+                    continue
+                for j in range(len(locals_) - 1 - skip, -1, -1):
+                    yield start + locals_[j]
+                skip = 0
+                continue
+
+            timestamps = segment.timestamps
+            for j in range(len(locals_) - 1, -1, -1):
+                if since <= timestamps[locals_[j]] <= until:
+                    if skip > 0:
+                        skip -= 1
+                    else:
+                        yield start + locals_[j]
+
+    def query(self, offset: int = 0, limit: int = 50, card_number: str = None,
+              since: datetime.datetime = None, until: datetime.datetime = None):
+        """Newest first page of log lines, optionally for one card and/or a time range.
+
+        Returns the lines and whether there are more after them.
+        """
+        since_ts = since.timestamp() if since else float("-inf")
+        until_ts = until.timestamp() if until else float("inf")
+
+        with self.lock:
+            if self.active_file is not None:
+                self.active_file.flush()
+            lines = list(itertools.islice(self._newest_first(card_number, since_ts, until_ts, offset), limit + 1))
+            return self._read(lines[:limit]), len(lines) > limit
+
+    def entries(self):
+        """(timestamp text, granted, card number) of every line, oldest segment first, for
+        rebuilding aggregates at startup. Sealed segments are inflated whole, one at a time.
+        """
+        with self.lock:
+            if self.active_file is not None:
+                self.active_file.flush()
+            segments = list(self.segments)
+
+        for segment in segments:
+            if segment.sealed:
+                with open(segment.path, "rb") as f:
+                    content = gzip.decompress(f.read())
+            else:
+                with open(segment.path, "rb") as f:
+                    content = f.read()
+            for line in content.decode(errors="replace").splitlines():
+                match = LINE_RE.match(line)
+                if match:
+                    yield match.group(1), match.group(2) == "granted", match.group(3)
+
+    def __len__(self):
+        return self.count - self.starts[0] if self.segments else 0
+
+    def close(self):
+        with self.lock:
+            if self.active_file is not None:
+                self.active_file.close()
+                self.read_file.close()
+                self.active_file = self.read_file = None
+
+
+FSYNC_POLICIES = ("never", "interval", "batch")
+
+
+class LogWriter:
+    """Appends to a LogStore from a background thread, so scans are answered without waiting
+    for the disk.
+
+    Events are queued by submit and committed in groups: the writer waits commit_delay seconds
+    after the first event of a group for more to arrive, then takes everything queued (up to
+    max_batch) and appends it with a single write. Scans do not wait for the commit, the delay
+    only trades a little freshness of the log for fewer, larger writes; callers that must know
+    the events are on disk wait on the ticket submit_many returns. The fsync policy decides how much
+    can be lost on a power cut: "batch" syncs every group before the next one, "interval"
+    at most every fsync_interval seconds, "never" leaves it to the OS. Listeners of the store
+    run on the writer thread.
+    """
+
+    def __init__(self, store: LogStore, max_batch: int = 1024, commit_delay: float = 0.005,
+                 fsync: str = "interval", fsync_interval: float = 1.0):
+        if fsync not in FSYNC_POLICIES:
+            raise ValueError(f"fsync policy must be one of {FSYNC_POLICIES}")
+
+        self.store = store
+        self.max_batch = max_batch
+        self.commit_delay = commit_delay
+        self.fsync = fsync
+        self.fsync_interval = fsync_interval
+        self.queue = queue.SimpleQueue()
+        self.done = threading.Condition()
+        self.submitted = 0
+        self.committed = 0
+        self.failed_ranges = deque(maxlen=64)   # (first, last) submission numbers of groups that failed
+        self.stats = {"batches": 0, "events": 0, "failed": 0, "max_batch": 0, "fsyncs": 0, "commit_ms": 0.0}
+        self.last_sync = time.monotonic()
+        self.thread = threading.Thread(target=self._run, name="log-writer", daemon=True)
+        self.thread.start()
+
+    def submit(self, card_number: str, result: int, when: datetime.datetime = None, reader: int = None):
+        # stamped now, the line carries the time of the decision and not of the commit
+        self.submit_many([(card_number, result, when or datetime.datetime.now(), reader)])
+
+    def submit_many(self, events):
+        """Queues the events, returns the ticket to wait for them with wait()."""
+        # queued under the lock so submission numbers follow the order of the queue
+        with self.done:
+            first = self.submitted
+            self.submitted += len(events)
+            for event in events:
+                self.queue.put(event)
+            return first, self.submitted
+
+    def _commit(self, batch):
+        start = time.perf_counter()
+        self.store.append_many(batch)
+
+        now = time.monotonic()
+        if self.fsync == "batch" or (self.fsync == "interval" and now - self.last_sync >= self.fsync_interval):
+            self.store.sync()
+            self.last_sync = now
+            self.stats["fsyncs"] += 1
+
+        self.stats["batches"] += 1
+        self.stats["events"] += len(batch)
+        self.stats["max_batch"] = max(self.stats["max_batch"], len(batch))
+        self.stats["commit_ms"] += (time.perf_counter() - start) * 1000
+
+    def _run(self):
+        while True:
+            event = self.queue.get()
+            if event is None:
+                break
+
+            if self.commit_delay > 0:
+                time.sleep(self.commit_delay)
+
+            batch = [event]
+            stop = False
+            while len(batch) < self.max_batch:
+                try:
+                    event = self.queue.get_nowait()
+                except queue.Empty:
+                    break
+                if event is None:
+                    stop = True
+                    break
+                batch.append(event)
+
+            try:
+                self._commit(batch)
+            except Exception as error:
+                # the events are lost but the writer keeps going for the next ones
+                print(f"Log writer failed to commit {len(batch)} events: {error!r}")
+                self.stats["failed"] += len(batch)
+                with self.done:
+                    self.failed_ranges.append((self.committed, self.committed + len(batch)))
+            finally:
+                with self.done:
+                    self.committed += len(batch)
+                    self.done.notify_all()
+            if stop:
+                break
+
+        if self.fsync != "never":
+            self.store.sync()
+
+    def flush(self, timeout: float = None) -> bool:
+        """Waits until every event submitted before the call is in the log."""
+        with self.done:
+            target = self.submitted
+            return self.done.wait_for(lambda: self.committed >= target, timeout)
+
+    def wait(self, ticket, timeout: float = None) -> bool:
+        """Waits until the events of a submit_many are written and synced to disk, whatever the
+        fsync policy. False if they were not in time, or their group failed.
+        """
+        with self.done:
+            if not self.done.wait_for(lambda: self.committed >= ticket[1], timeout):
+                return False
+            if self._failed(ticket):
+                return False
+        self.store.sync()
+        return True
+
+    def failed(self, ticket) -> bool:
+        """True once the events of a submit_many are known to be missing from the log."""
+        with self.done:
+            return self.committed >= ticket[1] and self._failed(ticket)
+
+    def _failed(self, ticket) -> bool:
+        first, last = ticket
+        return any(start < last and first < end for start, end in self.failed_ranges)
+
+    def summary(self):
+        batches = self.stats["batches"]
+        return dict(self.stats, queued=self.submitted - self.committed,
+                    mean_batch=self.stats["events"] / batches if batches else 0,
+                    mean_commit_ms=self.stats["commit_ms"] / batches if batches else 0)
+
+    def close(self):
+        # the events already queued are committed before the thread stops
+        self.queue.put(None)
+        self.thread.join()
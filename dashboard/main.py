@@ -1,69 +1,268 @@
 import uvicorn
-from fastapi import FastAPI, Request
-from fastapi.responses import HTMLResponse
+from fastapi import FastAPI, Header, HTTPException, Request
+from fastapi.responses import HTMLResponse, PlainTextResponse, StreamingResponse
 from fastapi.templating import Jinja2Templates
+from starlette.concurrency import run_in_threadpool
 
+import asyncio
 import datetime
+import os
+import time
 
-SERVER_IP = "192.168.43.241"
+from access_stats import AccessStats
+from acl_store import AclStore
+from live_events import LiveEvents
+from log_store import LogStore, LogWriter
+from scan_listener import start_scan_listener
+
+# SERVER_IP=127.0.0.1 to run it locally (e.g. for loadgen.py)
+SERVER_IP = os.environ.get("SERVER_IP", "192.168.43.241")
+SERVER_PORT = int(os.environ.get("SERVER_PORT", 80))
+SCAN_PORT = 4210
+# "batch" syncs every group of lines written, "interval" once a second at most, "never" leaves it to the OS
+LOG_FSYNC = os.environ.get("LOG_FSYNC", "interval")
+# sealed log segments kept (10000 lines each), 0 keeps them all
+LOG_MAX_SEGMENTS = int(os.environ.get("LOG_MAX_SEGMENTS", 0))
 
 app = FastAPI(title="RFID Project", version="Arquiteturas para Sistemas Embutidos")
 
 templates = Jinja2Templates(directory="templates")
 
+acl = AclStore("ACCESS")
+
+# segments under logs/, the old LOGFILE is imported the first time
+logs = LogStore("logs", legacy_file="LOGFILE", max_segments=LOG_MAX_SEGMENTS)
+
+# counters rebuilt from the log once, then updated by every line appended
+stats = AccessStats()
+stats.rebuild(logs.entries())
+logs.subscribe(stats.add)
+
+# every line logged is pushed to the pages open on /events
+live = LiveEvents()
+logs.subscribe(live.add)
+
+# scans are answered once decided, their lines are written in groups by a background thread
+writer = LogWriter(logs, fsync=LOG_FSYNC)
+
+PAGE_SIZE = 50
+# the reader gives up on an upload after 5 s, it is answered before
+UPLOAD_COMMIT_TIMEOUT = 3.0
+# a reader only uploads again the batch it did not see acknowledged (EVENT_BATCH_SIZE in
+# esp32/main/rfid.c), so a repeated event is less than a batch behind the newest one logged;
+# further back means its queue started over
+UPLOAD_REPLAY_WINDOW = 16
+
+# uploading reader -> (sequence of the newest event queued for the log, ticket of its upload)
+uploads = {}
+
+
+def parse_time(value: str):
+    # value of an <input type="datetime-local">
+    return datetime.datetime.fromisoformat(value) if value else None
+
+
+def dashboard_snapshot(page: int, card: str, since, until):
+    # the page continues live from the last line it shows, read under the same lock as the lines
+    with logs.lock:
+        lines, has_next = logs.query(page * PAGE_SIZE, PAGE_SIZE, card, since, until)
+        return lines, has_next, live.position()
+
 
 @app.get("/", response_class=HTMLResponse)
-async def dashboard(request: Request):
-    with open("LOGFILE", "r") as f:
-        logs = f.readlines()
-    
-    return templates.TemplateResponse("index.html", {"request": request, "logs": logs[::-1]})
+async def dashboard(request: Request, page: int = 0, card: str = None, since: str = None, until: str = None):
+    page = max(page, 0)
+    await run_in_threadpool(writer.flush, 1.0)
+    lines, has_next, last_event = await run_in_threadpool(dashboard_snapshot, page, card or None,
+                                                          parse_time(since), parse_time(until))
+
+    filters = {"card": card or "", "since": since or "", "until": until or ""}
+    return templates.TemplateResponse("index.html", {"request": request, "logs": lines, "page": page,
+                                                     "has_next": has_next, "filters": filters,
+                                                     "live": page == 0 and not until, "last_event": last_event,
+                                                     "page_size": PAGE_SIZE})
+
+
+@app.get("/events")
+async def events(after: str = None, last_event_id: str = Header(None)):
+    # Server-Sent Events, one message per line logged after the one with id after
+    # (Last-Event-ID when the browser reconnects), ids of an earlier run get a reset
+    start = last_event_id if last_event_id is not None else after
+    return StreamingResponse(live.stream(start if start is not None else live.position()),
+                             media_type="text/event-stream",
+                             headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"})
+
+
+@app.get("/logs")
+async def get_logs(page: int = 0, size: int = PAGE_SIZE, card: str = None, since: str = None, until: str = None):
+    # lines still queued are waited for, a reader sees its own accesses
+    await run_in_threadpool(writer.flush, 1.0)
+    lines, has_next = await run_in_threadpool(logs.query, max(page, 0) * size, size, card or None,
+                                              parse_time(since), parse_time(until))
+
+    return {"logs": [line.rstrip("\n") for line in lines], "page": page, "has_next": has_next}
+
+
+@app.get("/stats")
+async def get_stats(card: str = None, top: int = 10, days: int = 7, hours: int = 24):
+    # granted/denied totals, busiest cards, per day and per hour (hour_of_day for the busiest times)
+    if card:
+        return stats.card(card)
+
+    summary = stats.summary(top, min(max(days, 0), 366), min(max(hours, 0), 24 * 31))
+    summary["log_writer"] = writer.summary()
+    return summary
+
+
+@app.get("/access_list", response_class=PlainTextResponse)
+async def access_list():
+    # one serial number per line, cached by the readers for local decisions
+    return await run_in_threadpool(acl.snapshot)
+
+
+def access_changes_text(since: int) -> str:
+    # "delta V N" and one "+sn" or "-sn" per changed card, or "snapshot V N" and the whole list
+    # when the reader is too far behind, V being the version the reader has once applied and
+    # N the number of lines that follow, so a reader does not commit an answer cut short
+    version, changes = acl.changes_since(since)
+    if changes is None:
+        cards = acl.snapshot()
+        count = cards.count("\n")
+        return f"snapshot {version} {count}\n" + cards
+
+    return f"delta {version} {len(changes)}\n" + "".join(op + sn + "\n" for sn, op in changes.items())
+
+
+@app.get("/access_changes", response_class=PlainTextResponse)
+async def access_changes(since: int = 0):
+    # under the lock of the access list, which a change holds while it syncs
+    return await run_in_threadpool(access_changes_text, since)
 
 
+# changes are synced to the write-ahead log (and sometimes compacted) before they apply, on a
+# worker thread so scans answered on the loop do not wait for the disk
 @app.post("/add_access")
 async def add_access(card_number: str):
-    with open("ACCESS", "a") as f:
-        f.write(card_number + "\n")
+    await run_in_threadpool(acl.add, [card_number])
 
     return {"message": "Access added successfully for card number " + card_number}
 
 
 @app.post("/remove_access")
 async def remove_access(card_number: str):
-    with open("ACCESS", "r") as f:
-        serial_numbers = f.readlines()
-
-    with open("ACCESS", "w") as f:
-        for sn in serial_numbers:
-            if sn.replace("\n", "") != card_number:
-                print(sn)
-                f.write(sn)
+    await run_in_threadpool(acl.remove, [card_number])
 
     return {"message": "Access removed successfully for card number " + card_number}
 
 
+def card_list(data: dict) -> list:
+    # a bare string would be iterated digit by digit
+    cards = data.get("cards")
+    if not isinstance(cards, list) or not all(isinstance(card, str) for card in cards):
+        raise HTTPException(status_code=400, detail='"cards" must be a list of strings')
+    return cards
+
+
+@app.post("/add_access_batch")
+async def add_access_batch(data: dict):
+    added = await run_in_threadpool(acl.add, card_list(data))
+
+    return {"added": added, "total": len(acl)}
+
+
+@app.post("/remove_access_batch")
+async def remove_access_batch(data: dict):
+    removed = await run_in_threadpool(acl.remove, card_list(data))
+
+    return {"removed": removed, "total": len(acl)}
+
+
+def decide_access(card_number: str, reader_id: int = None) -> int:
+    result = 1 if acl.contains(card_number) else 0
+
+    writer.submit(card_number, result, reader=reader_id)
+
+    return result
+
+
+@app.on_event("startup")
+async def start_listeners():
+    # binary access checks (udp), /check_access stays for readers that fall back to http
+    await start_scan_listener(decide_access, SERVER_IP, SCAN_PORT)
+    live.attach(asyncio.get_running_loop())
+
+
+@app.on_event("shutdown")
+async def stop_writer():
+    # whatever is still queued is written before the log is closed
+    writer.close()
+    logs.close()
+
+
 @app.post("/check_access")
 async def check_access(data: dict):
+    return decide_access(data["sn"], data.get("reader"))
 
-    with open("ACCESS", "r") as f:
-        serial_numbers = f.readlines()
 
-    if data["sn"] + "\n" in serial_numbers:
-        result = 1
-    else:
-        result = 0
+@app.post("/log_access")
+async def log_reader_access(data: dict):
+    # decision already taken by the reader from its cached access list
+    writer.submit(data["sn"], int(data["access"]), reader=data.get("reader"))
 
-    if result:
-        access = "granted"
-    else:
-        access = "denied"
+    return {"message": "Access logged for card number " + data["sn"]}
 
-    timestamp = datetime.datetime.now().strftime("%d/%m/%Y %H:%M:%S")
 
-    with open("LOGFILE", "a") as f:
-        f.write(f"[{timestamp}] : Access {access} (card number {data['sn']})\n")
-    
-    return result
+def event_list(data: dict) -> list:
+    # a malformed batch is refused for good, a KeyError would answer 500 and be uploaded again
+    events = data.get("events")
+    if not isinstance(events, list) or not all(
+            isinstance(event, dict) and isinstance(event.get("sn"), str) and event.get("access") in (0, 1) and
+            all(isinstance(event.get(key, 0), int) for key in ("seq", "age", "reader"))
+            for event in events):
+        raise HTTPException(status_code=400, detail='"events" must be a list of {"sn": str, "access": 0 or 1}'
+                                                    ' with optional integer "seq", "age" and "reader"')
+    return events
+
+
+def already_logged(sequence: int, newest: int) -> bool:
+    # sequence numbers wrap around, like on the reader
+    return (newest - sequence) % 2**32 < UPLOAD_REPLAY_WINDOW
+
+
+@app.post("/log_access_batch")
+async def log_reader_access_batch(data: dict, request: Request):
+    # events the reader queued while offline, "age" is how long ago (ms) they happened
+    # and is missing for events recorded before the reader rebooted
+    events = event_list(data)
+    # sequence numbers are per reader, the address stands in for readers that do not send their id
+    key = data["reader"] if isinstance(data.get("reader"), int) else request.client.host
+
+    # an upload answered after the reader gave up on it comes again: the events already
+    # queued are not logged twice, the answer waits for their earlier upload instead
+    previous = uploads.get(key)
+    if previous is not None and writer.failed(previous[1]):
+        previous = None
+    if previous is not None:
+        events = [event for event in events if "seq" not in event or not already_logged(event["seq"], previous[0])]
+
+    now = datetime.datetime.now()
+    lines = [(event["sn"], event["access"], now - datetime.timedelta(milliseconds=event["age"]) if "age" in event
+              else now, event.get("reader")) for event in events]
+
+    # the reader erases its copies once answered, so they must be on disk first
+    tickets = [previous[1]] if previous is not None else []
+    if lines:
+        tickets.append(writer.submit_many(lines))
+        sequences = [event["seq"] for event in events if "seq" in event]
+        if sequences:
+            uploads[key] = (sequences[-1], tickets[-1])
+    deadline = time.monotonic() + UPLOAD_COMMIT_TIMEOUT
+    for ticket in tickets:
+        if not await run_in_threadpool(writer.wait, ticket, max(deadline - time.monotonic(), 0)):
+            raise HTTPException(status_code=503, detail="events not logged, upload them again")
+
+    return {"logged": len(lines)}
 
 if __name__ == "__main__":
-    uvicorn.run("main:app", host=SERVER_IP, port=80, reload=True)
+    # readers keep their connection open between scans
+    uvicorn.run("main:app", host=SERVER_IP, port=SERVER_PORT, reload=True, timeout_keep_alive=120)
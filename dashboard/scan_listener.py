@@ -0,0 +1,48 @@
+import asyncio
+import struct
+
+# 16-byte frames shared with the readers (esp32/components/esp-scanlink/scan_link.h):
+# magic, type, decision, reader id, sequence (uint32), serial number (uint64), little-endian
+FRAME = struct.Struct("<BBBBIQ")
+MAGIC = 0xA5
+REQUEST = 1
+RESPONSE = 2
+
+
+class ScanProtocol(asyncio.DatagramProtocol):
+    """Answers binary access checks, decide(card_number, reader_id) returns 0 or 1."""
+
+    def __init__(self, decide):
+        self.decide = decide
+        self.transport = None
+        self.answered = {}      # (address, reader id) -> last response, resent for retries
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, addr):
+        if len(data) != FRAME.size:
+            return
+
+        magic, kind, _, reader_id, sequence, serial_number = FRAME.unpack(data)
+        if magic != MAGIC or kind != REQUEST:
+            return
+
+        # a retry of the last request is answered again without logging it twice, the card must
+        # match too: a rebooted reader numbers its requests from a new random start
+        key = (addr, reader_id)
+        last = self.answered.get(key)
+        if last is not None and FRAME.unpack(last)[4:] == (sequence, serial_number):
+            self.transport.sendto(last, addr)
+            return
+
+        decision = self.decide(str(serial_number), reader_id)
+        response = FRAME.pack(MAGIC, RESPONSE, decision, reader_id, sequence, serial_number)
+        self.answered[key] = response
+        self.transport.sendto(response, addr)
+
+
+async def start_scan_listener(decide, host: str, port: int):
+    loop = asyncio.get_running_loop()
+    transport, _ = await loop.create_datagram_endpoint(lambda: ScanProtocol(decide), local_addr=(host, port))
+    return transport
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+#include "acl_cache.h"
+
+static int compare_serials(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Index of the first serial number not lower than the given one
+static size_t lower_bound(const acl_cache_t* cache, uint64_t serialNumber)
+{
+    size_t low = 0;
+    size_t high = cache->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (cache->serials[mid] < serialNumber)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+void acl_cache_init(acl_cache_t* cache, uint64_t* storage, size_t capacity)
+{
+    cache->serials = storage;
+    cache->count = 0;
+    cache->capacity = capacity;
+}
+
+void acl_cache_clear(acl_cache_t* cache)
+{
+    cache->count = 0;
+}
+
+esp_err_t acl_cache_push(acl_cache_t* cache, uint64_t serialNumber)
+{
+    if (cache->count >= cache->capacity) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    cache->serials[cache->count++] = serialNumber;
+    return ESP_OK;
+}
+
+void acl_cache_sort(acl_cache_t* cache)
+{
+    if (cache->count < 2) {
+        return;
+    }
+
+    qsort(cache->serials, cache->count, sizeof(uint64_t), compare_serials);
+
+    // drop duplicates
+    size_t unique = 1;
+    for (size_t i = 1; i < cache->count; i++) {
+        if (cache->serials[i] != cache->serials[unique - 1])
+            cache->serials[unique++] = cache->serials[i];
+    }
+    cache->count = unique;
+}
+
+esp_err_t acl_cache_load(acl_cache_t* cache, const uint64_t* pSerials, size_t count)
+{
+    if (count > cache->capacity) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(cache->serials, pSerials, count * sizeof(uint64_t));
+    cache->count = count;
+    acl_cache_sort(cache);
+
+    return ESP_OK;
+}
+
+bool acl_cache_contains(const acl_cache_t* cache, uint64_t serialNumber)
+{
+    size_t i = lower_bound(cache, serialNumber);
+    return i < cache->count && cache->serials[i] == serialNumber;
+}
+
+esp_err_t acl_cache_insert(acl_cache_t* cache, uint64_t serialNumber)
+{
+    size_t i = lower_bound(cache, serialNumber);
+    if (i < cache->count && cache->serials[i] == serialNumber) {
+        return ESP_OK;
+    }
+
+    if (cache->count >= cache->capacity) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memmove(&cache->serials[i + 1], &cache->serials[i], (cache->count - i) * sizeof(uint64_t));
+    cache->serials[i] = serialNumber;
+    cache->count++;
+
+    return ESP_OK;
+}
+
+esp_err_t acl_cache_remove(acl_cache_t* cache, uint64_t serialNumber)
+{
+    size_t i = lower_bound(cache, serialNumber);
+    if (i >= cache->count || cache->serials[i] != serialNumber) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memmove(&cache->serials[i], &cache->serials[i + 1], (cache->count - i - 1) * sizeof(uint64_t));
+    cache->count--;
+
+    return ESP_OK;
+}
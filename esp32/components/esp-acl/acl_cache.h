@@ -0,0 +1,30 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Sorted, duplicate-free array of card serial numbers.
+// The storage is provided by the caller, so the cache never allocates.
+typedef struct {
+    uint64_t* serials;
+    size_t count;
+    size_t capacity;
+} acl_cache_t;
+
+void acl_cache_init(acl_cache_t* cache, uint64_t* storage, size_t capacity);
+
+void acl_cache_clear(acl_cache_t* cache);
+
+// Appends without keeping the order, call acl_cache_sort() once done
+esp_err_t acl_cache_push(acl_cache_t* cache, uint64_t serialNumber);
+
+void acl_cache_sort(acl_cache_t* cache);
+
+esp_err_t acl_cache_load(acl_cache_t* cache, const uint64_t* pSerials, size_t count);
+
+bool acl_cache_contains(const acl_cache_t* cache, uint64_t serialNumber);
+
+esp_err_t acl_cache_insert(acl_cache_t* cache, uint64_t serialNumber);
+
+esp_err_t acl_cache_remove(acl_cache_t* cache, uint64_t serialNumber);
@@ -0,0 +1,270 @@
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "acl_cache.h"
+#include "acl_store.h"
+
+#define ACL_MAGIC_V1 0x41434c31 // "ACL1", a single copy at the start of the partition
+#define ACL_MAGIC 0x41434c32    // "ACL2"
+#define SECTOR_SIZE 4096
+
+// The partition holds two slots (halves) and saves alternate between them, the one not being
+// written keeps the previous list: a save cut short by a power loss leaves it to be loaded
+// instead of no list at all. The valid slot with the highest generation is the current one.
+#define ACL_SLOTS 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t crc;
+    uint32_t version;       // 0 in lists stored before versions existed
+    uint32_t generation;    // counts the saves, only in ACL2 headers
+} acl_header_t;
+
+static const char *TAG = "ACL_STORE";
+
+static uint64_t storage[2][ACL_STORE_CAPACITY];
+static acl_cache_t caches[2];
+static acl_cache_t* active = &caches[0];
+static acl_cache_t* pending = &caches[1];
+static bool ready = false;
+static uint32_t version = 0;
+
+static SemaphoreHandle_t lock;
+static const esp_partition_t* partition;
+static size_t slot_size;
+static int current_slot = -1;       // slot of the list loaded or saved last, -1 when none
+static uint32_t generation = 0;
+
+// Reads the list of a slot into serials, the header is filled in when it is valid
+static esp_err_t acl_store_read_slot(int slot, acl_header_t* pHeader, uint64_t* serials)
+{
+    size_t offset = slot * slot_size;
+    esp_err_t ret = esp_partition_read(partition, offset, pHeader, sizeof(*pHeader));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // the first format had one copy at offset 0 and a shorter header, the list follows it
+    size_t header_size = sizeof(acl_header_t);
+    if (slot == 0 && pHeader->magic == ACL_MAGIC_V1) {
+        header_size = offsetof(acl_header_t, generation);
+        pHeader->generation = 0;
+    } else if (pHeader->magic != ACL_MAGIC) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (pHeader->count > ACL_STORE_CAPACITY || header_size + pHeader->count * sizeof(uint64_t) > slot_size) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    ret = esp_partition_read(partition, offset + header_size, serials, pHeader->count * sizeof(uint64_t));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (esp_rom_crc32_le(0, (const uint8_t*)serials, pHeader->count * sizeof(uint64_t)) != pHeader->crc) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t acl_store_load(void)
+{
+    acl_header_t best = { 0 };
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    // the inactive buffer holds each slot while it is checked, the newest valid one is kept
+    for (int slot = 0; slot < ACL_SLOTS; slot++) {
+        acl_header_t header;
+        esp_err_t err = acl_store_read_slot(slot, &header, pending->serials);
+        if (err != ESP_OK) {
+            if (ret != ESP_OK && err != ESP_ERR_NOT_FOUND)
+                ret = err;
+            continue;
+        }
+        if (current_slot >= 0 && (int32_t)(header.generation - best.generation) <= 0)
+            continue;
+
+        acl_cache_t* previous = active;
+        active = pending;
+        pending = previous;
+        best = header;
+        current_slot = slot;
+        ret = ESP_OK;
+    }
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    active->count = best.count;
+    version = best.version;
+    generation = best.generation;
+    return ESP_OK;
+}
+
+static esp_err_t acl_store_save(const acl_cache_t* cache, uint32_t listVersion)
+{
+    size_t size = sizeof(acl_header_t) + cache->count * sizeof(uint64_t);
+    size_t erase_size = (size + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    if (erase_size > slot_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // the slot of the current list is left alone until the new one is complete
+    int slot = current_slot >= 0 ? (current_slot + 1) % ACL_SLOTS : 0;
+    size_t offset = slot * slot_size;
+    esp_err_t ret = esp_partition_erase_range(partition, offset, erase_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = esp_partition_write(partition, offset + sizeof(acl_header_t), cache->serials,
+                              cache->count * sizeof(uint64_t));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // header goes last, an interrupted save leaves no valid magic behind
+    acl_header_t header = {
+        .magic = ACL_MAGIC,
+        .count = cache->count,
+        .crc = esp_rom_crc32_le(0, (const uint8_t*)cache->serials, cache->count * sizeof(uint64_t)),
+        .version = listVersion,
+        .generation = generation + 1,
+    };
+    ret = esp_partition_write(partition, offset, &header, sizeof(header));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    current_slot = slot;
+    generation = header.generation;
+    return ESP_OK;
+}
+
+esp_err_t acl_store_init(void)
+{
+    acl_cache_init(&caches[0], storage[0], ACL_STORE_CAPACITY);
+    acl_cache_init(&caches[1], storage[1], ACL_STORE_CAPACITY);
+
+    lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ACL_STORE_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "Partition \"%s\" not found, the list will not survive a reboot", ACL_STORE_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot_size = partition->size / ACL_SLOTS / SECTOR_SIZE * SECTOR_SIZE;
+
+    esp_err_t ret = acl_store_load();
+    if (ret == ESP_OK) {
+        ready = true;
+        ESP_LOGI(TAG, "Loaded %u serial numbers from flash (version %lu, slot %d)", (unsigned)active->count,
+                 (unsigned long)version, current_slot);
+    } else {
+        ESP_LOGW(TAG, "No stored list (%s)", esp_err_to_name(ret));
+    }
+
+    return ESP_OK;
+}
+
+bool acl_store_is_ready(void)
+{
+    return ready;
+}
+
+bool acl_store_contains(uint64_t serialNumber)
+{
+    if (lock == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool found = acl_cache_contains(active, serialNumber);
+    xSemaphoreGive(lock);
+    return found;
+}
+
+size_t acl_store_count(void)
+{
+    return active->count;
+}
+
+uint32_t acl_store_version(void)
+{
+    return version;
+}
+
+esp_err_t acl_store_snapshot_begin(void)
+{
+    acl_cache_clear(pending);
+    return ESP_OK;
+}
+
+esp_err_t acl_store_snapshot_add(uint64_t serialNumber)
+{
+    return acl_cache_push(pending, serialNumber);
+}
+
+static esp_err_t acl_store_commit(uint32_t listVersion)
+{
+    bool changed = pending->count != active->count || listVersion != version ||
+                   memcmp(pending->serials, active->serials, pending->count * sizeof(uint64_t)) != 0;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    acl_cache_t* previous = active;
+    active = pending;
+    pending = previous;
+    version = listVersion;
+    ready = true;
+    xSemaphoreGive(lock);
+
+    if (!changed || partition == NULL) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = acl_store_save(active, listVersion);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to persist the list: %s", esp_err_to_name(ret));
+    } else {
+        ESP_LOGI(TAG, "Stored %u serial numbers (version %lu)", (unsigned)active->count, (unsigned long)listVersion);
+    }
+    return ret;
+}
+
+esp_err_t acl_store_snapshot_commit(uint32_t listVersion)
+{
+    acl_cache_sort(pending);
+    return acl_store_commit(listVersion);
+}
+
+esp_err_t acl_store_delta_begin(void)
+{
+    // only the sync task swaps the buffers, the active list can be read without the lock
+    return acl_cache_load(pending, active->serials, active->count);
+}
+
+esp_err_t acl_store_delta_add(uint64_t serialNumber)
+{
+    return acl_cache_insert(pending, serialNumber);
+}
+
+esp_err_t acl_store_delta_remove(uint64_t serialNumber)
+{
+    esp_err_t ret = acl_cache_remove(pending, serialNumber);
+    return ret == ESP_ERR_NOT_FOUND ? ESP_OK : ret;
+}
+
+esp_err_t acl_store_delta_commit(uint32_t listVersion)
+{
+    return acl_store_commit(listVersion);
+}
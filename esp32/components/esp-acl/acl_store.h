@@ -0,0 +1,45 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Maximum number of serial numbers kept on the device (8 bytes each, double buffered, so
+// 32 KB of RAM). Larger lists keep their first ones and the other cards are checked with
+// the dashboard. Each of the two slots of the partition must hold one list.
+#ifndef ACL_STORE_CAPACITY
+#define ACL_STORE_CAPACITY 2048
+#endif
+
+// Data partition holding the persisted list (see partitions.csv)
+#define ACL_STORE_PARTITION "acl"
+
+esp_err_t acl_store_init(void);
+
+// True once a list was loaded from flash or synchronised from the dashboard
+bool acl_store_is_ready(void);
+
+bool acl_store_contains(uint64_t serialNumber);
+
+size_t acl_store_count(void);
+
+// Version of the list on the dashboard this copy matches, 0 when unknown
+uint32_t acl_store_version(void);
+
+// A new list is built in the inactive buffer and only becomes visible on commit,
+// so lookups keep answering from the previous list while it is downloaded
+esp_err_t acl_store_snapshot_begin(void);
+
+esp_err_t acl_store_snapshot_add(uint64_t serialNumber);
+
+esp_err_t acl_store_snapshot_commit(uint32_t version);
+
+// Same for a delta: the inactive buffer starts as a copy of the current list, the changes
+// are applied to it and all of them become visible at once on commit
+esp_err_t acl_store_delta_begin(void);
+
+esp_err_t acl_store_delta_add(uint64_t serialNumber);
+
+esp_err_t acl_store_delta_remove(uint64_t serialNumber);
+
+esp_err_t acl_store_delta_commit(uint32_t version);
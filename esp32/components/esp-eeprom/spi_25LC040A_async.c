@@ -0,0 +1,261 @@
+#include <string.h>
+#include <driver/spi_master.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "spi_25LC040A_async.h"
+
+#define QUEUE_LENGTH 8
+#define SUBMIT_TIMEOUT_MS 100
+#define TASK_STACK_SIZE 3072
+#define TASK_PRIORITY 3
+#define STATS_PERIOD 32
+
+// 4-Kbit SPI Bus Serial EEPROM - p.3, internal write cycle time is 5 ms max
+#define WRITE_CYCLE_MS 5
+#define WRITE_TIMEOUT_MS 20
+
+typedef struct {
+    uint16_t address;
+    uint8_t size;                  // 0 for a flush barrier
+    uint8_t data[SPI_25LC040_ASYNC_MAX_WRITE];
+    spi_25LC040_async_cb_t cb;
+    void* ctx;
+    int64_t submittedUs;
+} async_request_t;
+
+static const char* TAG = "eeprom_async";
+
+static spi_device_handle_t device;
+static QueueHandle_t requests;
+static SemaphoreHandle_t device_lock;      // held by the worker for a whole request
+static SemaphoreHandle_t flush_lock;       // one flush barrier in flight at a time
+static SemaphoreHandle_t flush_done;
+static spi_25LC040_async_stats_t stats;
+
+// The transactions outlive the call that queues them, their buffers are static, word aligned
+// and in DMA capable memory so the driver hands them to DMA without copying
+static DMA_ATTR uint8_t wren_tx[4];
+static DMA_ATTR uint8_t write_tx[2 + SPI_25LC040_PAGE_SIZE + 2];
+static DMA_ATTR uint8_t rdsr_rx[4];
+static spi_transaction_t wren_trans, write_trans;
+static spi_transaction_ext_t rdsr_trans;        // RDSR in the command phase, only MISO in the data phase
+
+static esp_err_t queue_and_wait(spi_transaction_t** pTrans, int count)
+{
+    for (int i = 0; i < count; i++) {
+        esp_err_t ret = spi_device_queue_trans(device, pTrans[i], portMAX_DELAY);
+        if (ret != ESP_OK)
+            return ret;
+    }
+
+    // the bus runs the queue back to back, the worker sleeps until the last one is done
+    for (int i = 0; i < count; i++) {
+        spi_transaction_t* done;
+        esp_err_t ret = spi_device_get_trans_result(device, &done, portMAX_DELAY);
+        if (ret != ESP_OK)
+            return ret;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t wait_write_cycle(void)
+{
+    int64_t start = esp_timer_get_time();
+    TickType_t step = pdMS_TO_TICKS(WRITE_CYCLE_MS) > 0 ? pdMS_TO_TICKS(WRITE_CYCLE_MS) : 1;
+    TickType_t waited = 0;
+
+    // 4-Kbit SPI Bus Serial EEPROM - p.6, the WIP bit reads 1 while a write cycle is in progress
+    while (1) {
+        vTaskDelay(step);
+        waited += step;
+
+        spi_transaction_t* trans[] = { &rdsr_trans.base };
+        esp_err_t ret = queue_and_wait(trans, 1);
+        if (ret != ESP_OK)
+            return ret;
+        if (!(rdsr_rx[0] & SPI_25LC040_STATUS_WIP))
+            break;
+        if (waited >= pdMS_TO_TICKS(WRITE_TIMEOUT_MS) + 1)
+            return ESP_ERR_TIMEOUT;
+        step = 1;
+    }
+
+    stats.cycleWaitUs += esp_timer_get_time() - start;
+    return ESP_OK;
+}
+
+static esp_err_t write_page(uint16_t address, const uint8_t* pData, size_t size)
+{
+    // 4-Kbit SPI Bus Serial EEPROM - p.10
+    // FIGURE 3-3: PAGE WRITE SEQUENCE, preceded by WREN in the same queue
+    write_tx[0] = SPI_25LC040_CMD_WRITE | ((address >> 8 & 0x01) << 3);
+    write_tx[1] = address;
+    memcpy(&write_tx[2], pData, size);
+    write_trans.length = (2 + size) * 8;
+
+    spi_25LC040_bus_stats_t before = spi_25LC040_get_bus_stats();
+    spi_transaction_t* trans[] = { &wren_trans, &write_trans };
+    esp_err_t ret = queue_and_wait(trans, 2);
+    if (ret == ESP_OK)
+        ret = wait_write_cycle();
+
+    stats.busUs += spi_25LC040_get_bus_stats().busyUs - before.busyUs;
+    stats.pages++;
+    return ret;
+}
+
+static esp_err_t write_block(uint16_t address, const uint8_t* pData, size_t size)
+{
+    // a write must not cross a page boundary, split the block at each one
+    while (size > 0) {
+        size_t room = SPI_25LC040_PAGE_SIZE - (address % SPI_25LC040_PAGE_SIZE);
+        size_t chunk = size < room ? size : room;
+
+        esp_err_t ret = write_page(address, pData, chunk);
+        if (ret != ESP_OK)
+            return ret;
+
+        address += chunk;
+        pData += chunk;
+        size -= chunk;
+    }
+    return ESP_OK;
+}
+
+static void log_stats(void)
+{
+    ESP_LOGI(TAG, "%lu writes (%lu failed), %lu pages, bus %llu us/page, write cycle %llu us/page, max latency %lu us",
+             (unsigned long)stats.writes, (unsigned long)stats.failed, (unsigned long)stats.pages,
+             (unsigned long long)(stats.busUs / stats.pages), (unsigned long long)(stats.cycleWaitUs / stats.pages),
+             (unsigned long)stats.maxLatencyUs);
+}
+
+static void async_task(void* arg)
+{
+    async_request_t request;
+
+    while (1) {
+        xQueueReceive(requests, &request, portMAX_DELAY);
+
+        if (request.size == 0) {
+            xSemaphoreGive(flush_done);
+            continue;
+        }
+
+        xSemaphoreTake(device_lock, portMAX_DELAY);
+        esp_err_t ret = write_block(request.address, request.data, request.size);
+        xSemaphoreGive(device_lock);
+
+        uint32_t latency = esp_timer_get_time() - request.submittedUs;
+        if (latency > stats.maxLatencyUs)
+            stats.maxLatencyUs = latency;
+        stats.writes++;
+        if (ret != ESP_OK)
+            stats.failed++;
+
+        if (request.cb != NULL)
+            request.cb(ret, request.ctx);
+
+        if (stats.writes % STATS_PERIOD == 0)
+            log_stats();
+    }
+}
+
+esp_err_t spi_25LC040_async_start(spi_device_handle_t devHandle)
+{
+    static StaticQueue_t queue_storage;
+    static uint8_t queue_buffer[QUEUE_LENGTH * sizeof(async_request_t)];
+    static StaticSemaphore_t device_lock_storage, flush_lock_storage, flush_done_storage;
+
+    if (requests != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    device = devHandle;
+    requests = xQueueCreateStatic(QUEUE_LENGTH, sizeof(async_request_t), queue_buffer, &queue_storage);
+    device_lock = xSemaphoreCreateMutexStatic(&device_lock_storage);
+    flush_lock = xSemaphoreCreateMutexStatic(&flush_lock_storage);
+    flush_done = xSemaphoreCreateBinaryStatic(&flush_done_storage);
+
+    wren_tx[0] = SPI_25LC040_CMD_WREN;
+    wren_trans = (spi_transaction_t) { .length = 8, .tx_buffer = wren_tx };
+    write_trans = (spi_transaction_t) { .tx_buffer = write_tx };
+    rdsr_trans = (spi_transaction_ext_t) {
+        .base = { .flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR, .cmd = SPI_25LC040_CMD_RDSR,
+                  .rxlength = 8, .rx_buffer = rdsr_rx },
+        .command_bits = 8,
+        .address_bits = 0,
+    };
+
+    if (xTaskCreate(async_task, "eeprom_async", TASK_STACK_SIZE, NULL, TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the writer task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t spi_25LC040_write_block_async(uint16_t address, const uint8_t* pBuffer, size_t size,
+                                        spi_25LC040_async_cb_t cb, void* ctx)
+{
+    if (size == 0 || size > SPI_25LC040_ASYNC_MAX_WRITE || address + size > SPI_25LC040_SIZE)
+        return ESP_ERR_INVALID_ARG;
+    if (requests == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    async_request_t request = {
+        .address = address,
+        .size = size,
+        .cb = cb,
+        .ctx = ctx,
+        .submittedUs = esp_timer_get_time(),
+    };
+    memcpy(request.data, pBuffer, size);
+
+    if (xQueueSend(requests, &request, pdMS_TO_TICKS(SUBMIT_TIMEOUT_MS)) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+    return ESP_OK;
+}
+
+esp_err_t spi_25LC040_async_flush(TickType_t timeout)
+{
+    if (requests == NULL)
+        return ESP_OK;
+    if (xSemaphoreTake(flush_lock, timeout) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+
+    // the queue is in order, the barrier comes out once everything before it is written
+    async_request_t barrier = { .size = 0 };
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(flush_done, 0);     // left over by a flush that timed out
+    if (xQueueSend(requests, &barrier, timeout) != pdTRUE || xSemaphoreTake(flush_done, timeout) != pdTRUE)
+        ret = ESP_ERR_TIMEOUT;
+
+    xSemaphoreGive(flush_lock);
+    return ret;
+}
+
+esp_err_t spi_25LC040_async_lock(TickType_t timeout)
+{
+    if (requests == NULL)
+        return ESP_OK;
+
+    esp_err_t ret = spi_25LC040_async_flush(timeout);
+    if (ret != ESP_OK)
+        return ret;
+    return xSemaphoreTake(device_lock, timeout) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void spi_25LC040_async_unlock(void)
+{
+    if (requests != NULL)
+        xSemaphoreGive(device_lock);
+}
+
+spi_25LC040_async_stats_t spi_25LC040_async_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "spi_25LC040A_eeprom.h"
+
+// Background writes to the 25LC040A. A worker task queues the transactions of each page
+// (spi_device_queue_trans, DMA) and sleeps through the 5 ms write cycle instead of polling
+// the status register from the caller, so the RC522 readers get the bus and the CPU while
+// the EEPROM is busy. Synchronous calls on the same device must be made between
+// spi_25LC040_async_lock and spi_25LC040_async_unlock once the worker is running.
+
+// Largest write accepted by spi_25LC040_write_block_async, the data is copied
+#define SPI_25LC040_ASYNC_MAX_WRITE 32
+
+typedef void (*spi_25LC040_async_cb_t)(esp_err_t result, void* ctx);
+
+typedef struct {
+    uint32_t writes;
+    uint32_t failed;
+    uint32_t pages;
+    uint64_t busUs;           // bus held by the worker's transactions
+    uint64_t cycleWaitUs;     // spent sleeping through write cycles, bus and CPU free
+    uint32_t maxLatencyUs;    // submit to callback
+} spi_25LC040_async_stats_t;
+
+esp_err_t spi_25LC040_async_start(spi_device_handle_t devHandle);
+
+// Copies the data and returns, cb runs in the worker task once it is stored (cb may be NULL)
+esp_err_t spi_25LC040_write_block_async(uint16_t address, const uint8_t* pBuffer, size_t size,
+                                        spi_25LC040_async_cb_t cb, void* ctx);
+
+// Waits until every write submitted before the call is done
+esp_err_t spi_25LC040_async_flush(TickType_t timeout);
+
+// Flushes and keeps the worker off the device until unlock
+esp_err_t spi_25LC040_async_lock(TickType_t timeout);
+
+void spi_25LC040_async_unlock(void);
+
+spi_25LC040_async_stats_t spi_25LC040_async_get_stats(void);
@@ -2,6 +2,12 @@
 #include <driver/spi_master.h>
 #include "spi_25LC040A_eeprom.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
 
 // ESP32 Technical Reference Manual - p.122
 // Table 7-2. Command Definitions Supported by GPSPI Slave in Halfduplex Mode
@@ -13,6 +19,50 @@
 #define CMD_WREN 0x06
 
 #define PAGE_SIZE 16
+#define EEPROM_SIZE 512
+
+// With DMA one transaction can read the whole device
+#define MAX_TRANSFER_SIZE EEPROM_SIZE
+#define QUEUE_SIZE 8
+
+// 4-Kbit SPI Bus Serial EEPROM - p.6, status register bit 0
+#define STATUS_WIP 0x01
+
+// 4-Kbit SPI Bus Serial EEPROM - p.3, internal write cycle time is 5 ms max
+#define WRITE_TIMEOUT_US 10000
+#define WRITE_POLL_INTERVAL_US 100
+
+static int64_t trans_start_us;
+static spi_25LC040_bus_stats_t bus_stats;
+
+// called around every transaction of the device, from the SPI interrupt for queued ones
+static void IRAM_ATTR bus_pre_cb(spi_transaction_t* trans)
+{
+    (void)trans;
+    trans_start_us = esp_timer_get_time();
+}
+
+static void IRAM_ATTR bus_post_cb(spi_transaction_t* trans)
+{
+    (void)trans;
+    bus_stats.transactions++;
+    bus_stats.busyUs += esp_timer_get_time() - trans_start_us;
+}
+
+// With DMA the driver refuses a half-duplex transaction with both a MOSI and a MISO data phase,
+// so reads send the instruction and address in the command and address phases instead
+static void read_transaction(spi_transaction_ext_t* pTrans, uint8_t instruction, int addressBits, uint16_t address,
+                             void* pData, size_t size)
+{
+    memset(pTrans, 0, sizeof(*pTrans));
+    pTrans->base.flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR;
+    pTrans->base.cmd = instruction;
+    pTrans->base.addr = address;
+    pTrans->base.rxlength = size * 8;
+    pTrans->base.rx_buffer = pData;
+    pTrans->command_bits = 8;
+    pTrans->address_bits = addressBits;
+}
 
 esp_err_t spi_25LC040_init(spi_host_device_t masterHostId, int csPin, int sckPin, int mosiPin, int misoPin, int clkSpeedHz, spi_device_handle_t *pDevHandle)
 {
@@ -24,7 +74,7 @@ esp_err_t spi_25LC040_init(spi_host_device_t masterHostId, int csPin, int sckPin
         .sclk_io_num = sckPin,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = 32,
+        .max_transfer_sz = MAX_TRANSFER_SIZE + 4,
     };
 
     spi_device_interface_config_t masterCfg = {
@@ -35,10 +85,13 @@ esp_err_t spi_25LC040_init(spi_host_device_t masterHostId, int csPin, int sckPin
         .clock_speed_hz = clkSpeedHz,
         .spics_io_num = csPin,
         .flags = SPI_DEVICE_HALFDUPLEX,
-        .queue_size = 1
+        .queue_size = QUEUE_SIZE,
+        .pre_cb = bus_pre_cb,
+        .post_cb = bus_post_cb
     };
 
-    ret = spi_bus_initialize(masterHostId, &spiBusCfg, SPI_DMA_DISABLED);
+    // DMA lifts the 64-byte limit of a transaction and lets queued ones run without the CPU
+    ret = spi_bus_initialize(masterHostId, &spiBusCfg, SPI_DMA_CH_AUTO);
     ESP_ERROR_CHECK(ret);
 
     ret = spi_bus_add_device(masterHostId, &masterCfg, pDevHandle);
@@ -64,22 +117,16 @@ esp_err_t spi_25LC040_free(spi_host_device_t masterHostId, spi_device_handle_t d
 esp_err_t spi_25LC040_read_byte(spi_device_handle_t devHandle, uint16_t address, uint8_t *pData)
 {
     esp_err_t ret;
-    spi_transaction_t spiTrans;
-
-    memset(&spiTrans, 0, sizeof(spiTrans));
+    spi_transaction_ext_t spiTrans;
 
     // 4-Kbit SPI Bus Serial EEPROM - p.8
     // FIGURE 3-1: READ SEQUENCE
-    uint8_t read_seq[2];
     uint16_t addr_msb = address >> 8 & 0x01;
-    read_seq[0] = CMD_READ | (addr_msb << 3);     // Instruction+Address MSb
-    read_seq[1] = address;                        // Lower Address Byte
-    spiTrans.length = sizeof(read_seq) * 8;
-    spiTrans.tx_buffer = read_seq;
-    spiTrans.rxlength = 8;
-    spiTrans.rx_buffer = pData;                   // Data Out
+    read_transaction(&spiTrans, CMD_READ | (addr_msb << 3),   // Instruction+Address MSb
+                     8, address & 0xFF,                        // Lower Address Byte
+                     pData, 1);                                // Data Out
 
-    ret = spi_device_polling_transmit(devHandle, &spiTrans);
+    ret = spi_device_polling_transmit(devHandle, &spiTrans.base);
     assert(ret == ESP_OK);
 
     return ret;
@@ -106,15 +153,13 @@ esp_err_t spi_25LC040_write_byte(spi_device_handle_t devHandle, uint16_t address
     ret = spi_device_polling_transmit(devHandle, &spiTrans);
     assert(ret == ESP_OK);
 
-    // Add a delay to allow time for the write operation to complete
-    vTaskDelay(pdMS_TO_TICKS(10)); // Adjust the delay time as necessary
-
-    return ret;
+    return spi_25LC040_wait_ready(devHandle, WRITE_TIMEOUT_US);
 }
 
 esp_err_t spi_25LC040_write_page(spi_device_handle_t devHandle, uint16_t address, const uint8_t* pBuffer, uint8_t size)
 {
-    if (size > PAGE_SIZE) {
+    // a page write wraps around inside its page, never across
+    if (size > PAGE_SIZE || (address % PAGE_SIZE) + size > PAGE_SIZE) {
         return ESP_ERR_INVALID_ARG;
     }
 
@@ -131,13 +176,13 @@ esp_err_t spi_25LC040_write_page(spi_device_handle_t devHandle, uint16_t address
     write_seq[1] = address;                        // Lower Address Byte
     memcpy(&write_seq[2], pBuffer, size);          // Data Bytes
 
-    spiTrans.length = sizeof(write_seq) * 8;
+    spiTrans.length = (2 + size) * 8;
     spiTrans.tx_buffer = write_seq;
 
     ret = spi_device_polling_transmit(devHandle, &spiTrans);
     assert(ret == ESP_OK);
 
-    return ret;
+    return spi_25LC040_wait_ready(devHandle, WRITE_TIMEOUT_US);
 }
 
 esp_err_t spi_25LC040_write_enable(spi_device_handle_t devHandle)
@@ -184,20 +229,14 @@ esp_err_t spi_25LC040_write_disable(spi_device_handle_t devHandle)
 esp_err_t spi_25LC040_read_status(spi_device_handle_t devHandle, uint8_t *pStatus)
 {
     esp_err_t ret;
-    spi_transaction_t spiTrans;
-
-    memset(&spiTrans, 0, sizeof(spiTrans));
+    spi_transaction_ext_t spiTrans;
 
     // 4-Kbit SPI Bus Serial EEPROM - p.12
     // FIGURE 3-6: READ STATUS REGISTER TIMING SEQUENCE (RDSR)
-    uint8_t read_seq[2];
-    read_seq[0] = CMD_RDSR;                         // Instruction
-    spiTrans.length = sizeof(read_seq) * 8;
-    spiTrans.tx_buffer = read_seq;
-    spiTrans.rxlength = 8;
-    spiTrans.rx_buffer = pStatus;                   // Data Out
+    read_transaction(&spiTrans, CMD_RDSR, 0, 0,      // Instruction
+                     pStatus, 1);                    // Data Out
 
-    ret = spi_device_polling_transmit(devHandle, &spiTrans);
+    ret = spi_device_polling_transmit(devHandle, &spiTrans.base);
     assert(ret == ESP_OK);
 
     return ret;
@@ -222,5 +261,93 @@ esp_err_t spi_25LC040_write_status(spi_device_handle_t devHandle, uint8_t status
     ret = spi_device_polling_transmit(devHandle, &spiTrans);
     assert(ret == ESP_OK);
 
-    return ret;
-}
\ No newline at end of file
+    return spi_25LC040_wait_ready(devHandle, WRITE_TIMEOUT_US);
+}
+
+esp_err_t spi_25LC040_wait_ready(spi_device_handle_t devHandle, uint32_t timeoutUs)
+{
+    int64_t deadline = esp_timer_get_time() + timeoutUs;
+    uint8_t status;
+
+    // 4-Kbit SPI Bus Serial EEPROM - p.6
+    // the WIP bit reads 1 while a write cycle is in progress
+    while (1) {
+        esp_err_t ret = spi_25LC040_read_status(devHandle, &status);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (!(status & STATUS_WIP)) {
+            return ESP_OK;
+        }
+        if (esp_timer_get_time() >= deadline) {
+            return ESP_ERR_TIMEOUT;
+        }
+        esp_rom_delay_us(WRITE_POLL_INTERVAL_US);
+    }
+}
+
+esp_err_t spi_25LC040_read_block(spi_device_handle_t devHandle, uint16_t address, uint8_t *pBuffer, size_t size)
+{
+    if (address + size > EEPROM_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 4-Kbit SPI Bus Serial EEPROM - p.8
+    // the address pointer keeps incrementing while clocks are sent,
+    // so each transaction reads as many bytes as the bus allows
+    while (size > 0) {
+        size_t chunk = size < MAX_TRANSFER_SIZE ? size : MAX_TRANSFER_SIZE;
+        spi_transaction_ext_t spiTrans;
+
+        uint16_t addr_msb = address >> 8 & 0x01;
+        read_transaction(&spiTrans, CMD_READ | (addr_msb << 3),   // Instruction+Address MSb
+                         8, address & 0xFF,                        // Lower Address Byte
+                         pBuffer, chunk);                          // Data Out
+
+        esp_err_t ret = spi_device_polling_transmit(devHandle, &spiTrans.base);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        address += chunk;
+        pBuffer += chunk;
+        size -= chunk;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t spi_25LC040_write_block(spi_device_handle_t devHandle, uint16_t address, const uint8_t *pBuffer, size_t size)
+{
+    if (address + size > EEPROM_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 4-Kbit SPI Bus Serial EEPROM - p.10
+    // a write must not cross a page boundary, split the block at each one
+    while (size > 0) {
+        size_t room = PAGE_SIZE - (address % PAGE_SIZE);
+        size_t chunk = size < room ? size : room;
+
+        esp_err_t ret = spi_25LC040_write_enable(devHandle);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        ret = spi_25LC040_write_page(devHandle, address, pBuffer, chunk);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        address += chunk;
+        pBuffer += chunk;
+        size -= chunk;
+    }
+
+    return ESP_OK;
+}
+
+spi_25LC040_bus_stats_t spi_25LC040_get_bus_stats(void)
+{
+    return bus_stats;
+}
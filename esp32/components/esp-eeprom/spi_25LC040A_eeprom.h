@@ -1,6 +1,21 @@
 #pragma once
 #include <driver/spi_master.h>
 
+// Page and size of the 25LC040A, for callers splitting their own writes
+#define SPI_25LC040_PAGE_SIZE 16
+#define SPI_25LC040_SIZE 512
+
+// 25LC040A instructions, the address MSb goes in bit 3 of the instruction byte
+#define SPI_25LC040_CMD_WRITE 0x02
+#define SPI_25LC040_CMD_RDSR 0x05
+#define SPI_25LC040_CMD_WREN 0x06
+#define SPI_25LC040_STATUS_WIP 0x01
+
+typedef struct {
+    uint32_t transactions;
+    uint64_t busyUs;         // time the device held the bus, the other devices wait meanwhile
+} spi_25LC040_bus_stats_t;
+
 esp_err_t spi_25LC040_init(spi_host_device_t masterHostId,
                            int csPin, int sckPin, int mosiPin, int misoPin,
                            int clkSpeedHz, spi_device_handle_t* pDevHandle);
@@ -22,4 +37,17 @@ esp_err_t spi_25LC040_write_disable(spi_device_handle_t devHandle);
 
 esp_err_t spi_25LC040_read_status(spi_device_handle_t devHandle, uint8_t* pStatus);
 
-esp_err_t spi_25LC040_write_status(spi_device_handle_t devHandle, uint8_t status);
\ No newline at end of file
+esp_err_t spi_25LC040_write_status(spi_device_handle_t devHandle, uint8_t status);
+
+// Polls the status register until the write cycle in progress is over
+esp_err_t spi_25LC040_wait_ready(spi_device_handle_t devHandle, uint32_t timeoutUs);
+
+// Sequential read of any length, in as few transactions as the bus allows
+esp_err_t spi_25LC040_read_block(spi_device_handle_t devHandle,
+                                 uint16_t address, uint8_t* pBuffer, size_t size);
+
+// Write of any length, split at page boundaries, returns once the data is stored
+esp_err_t spi_25LC040_write_block(spi_device_handle_t devHandle,
+                                  uint16_t address, const uint8_t* pBuffer, size_t size);
+
+spi_25LC040_bus_stats_t spi_25LC040_get_bus_stats(void);
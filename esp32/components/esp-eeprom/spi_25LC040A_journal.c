@@ -0,0 +1,156 @@
+#include <string.h>
+#include "spi_25LC040A_eeprom.h"
+#include "spi_25LC040A_journal.h"
+
+// Record layout, little endian
+#define OFFSET_SERIAL 0
+#define OFFSET_SEQUENCE 8
+#define OFFSET_DECISION 12
+#define OFFSET_CRC 14
+
+// CRC-16/CCITT-FALSE
+static uint16_t journal_crc16(const uint8_t* pData, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)pData[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static void journal_encode(uint8_t* pRecord, uint64_t serialNumber, uint32_t sequence, uint8_t decision)
+{
+    memset(pRecord, 0, JOURNAL_RECORD_SIZE);
+    for (int i = 0; i < 8; i++)
+        pRecord[OFFSET_SERIAL + i] = serialNumber >> (i * 8);
+    for (int i = 0; i < 4; i++)
+        pRecord[OFFSET_SEQUENCE + i] = sequence >> (i * 8);
+    pRecord[OFFSET_DECISION] = decision;
+
+    uint16_t crc = journal_crc16(pRecord, OFFSET_CRC);
+    pRecord[OFFSET_CRC] = crc;
+    pRecord[OFFSET_CRC + 1] = crc >> 8;
+}
+
+// Erased or torn pages fail the CRC and are skipped
+static bool journal_decode(const uint8_t* pRecord, eeprom_journal_entry_t* pEntry)
+{
+    uint16_t crc = pRecord[OFFSET_CRC] | (uint16_t)pRecord[OFFSET_CRC + 1] << 8;
+    if (journal_crc16(pRecord, OFFSET_CRC) != crc) {
+        return false;
+    }
+
+    pEntry->serialNumber = 0;
+    for (int i = 0; i < 8; i++)
+        pEntry->serialNumber |= (uint64_t)pRecord[OFFSET_SERIAL + i] << (i * 8);
+    pEntry->sequence = 0;
+    for (int i = 0; i < 4; i++)
+        pEntry->sequence |= (uint32_t)pRecord[OFFSET_SEQUENCE + i] << (i * 8);
+    pEntry->decision = pRecord[OFFSET_DECISION];
+
+    return true;
+}
+
+esp_err_t eeprom_journal_init(eeprom_journal_t* pJournal, spi_device_handle_t devHandle)
+{
+    uint8_t contents[JOURNAL_SLOTS * JOURNAL_RECORD_SIZE];
+
+    pJournal->devHandle = devHandle;
+    pJournal->head = 0;
+    pJournal->count = 0;
+    pJournal->nextSequence = 0;
+
+    esp_err_t ret = spi_25LC040_read_block(devHandle, 0x00, contents, sizeof(contents));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // the newest record is the one with the highest sequence number (wrap-around safe)
+    bool found = false;
+    uint32_t newest = 0;
+    for (int slot = 0; slot < JOURNAL_SLOTS; slot++) {
+        eeprom_journal_entry_t entry;
+        if (!journal_decode(&contents[slot * JOURNAL_RECORD_SIZE], &entry))
+            continue;
+
+        pJournal->count++;
+        if (!found || (int32_t)(entry.sequence - newest) > 0) {
+            found = true;
+            newest = entry.sequence;
+            pJournal->head = (slot + 1) % JOURNAL_SLOTS;
+        }
+    }
+
+    if (found)
+        pJournal->nextSequence = newest + 1;
+
+    return ESP_OK;
+}
+
+esp_err_t eeprom_journal_append(eeprom_journal_t* pJournal, uint64_t serialNumber, uint8_t decision)
+{
+    uint8_t record[JOURNAL_RECORD_SIZE];
+    journal_encode(record, serialNumber, pJournal->nextSequence, decision);
+
+    esp_err_t ret = spi_25LC040_write_block(pJournal->devHandle, pJournal->head * JOURNAL_RECORD_SIZE, record, sizeof(record));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    pJournal->head = (pJournal->head + 1) % JOURNAL_SLOTS;
+    pJournal->nextSequence++;
+    if (pJournal->count < JOURNAL_SLOTS)
+        pJournal->count++;
+
+    return ESP_OK;
+}
+
+void eeprom_journal_next(eeprom_journal_t* pJournal, uint64_t serialNumber, uint8_t decision,
+                         uint16_t* pAddress, uint8_t pRecord[JOURNAL_RECORD_SIZE])
+{
+    journal_encode(pRecord, serialNumber, pJournal->nextSequence, decision);
+    *pAddress = pJournal->head * JOURNAL_RECORD_SIZE;
+
+    pJournal->head = (pJournal->head + 1) % JOURNAL_SLOTS;
+    pJournal->nextSequence++;
+    if (pJournal->count < JOURNAL_SLOTS)
+        pJournal->count++;
+}
+
+esp_err_t eeprom_journal_read_last(eeprom_journal_t* pJournal, eeprom_journal_entry_t* pEntries,
+                                   size_t maxEntries, size_t* pCount)
+{
+    uint8_t contents[JOURNAL_SLOTS * JOURNAL_RECORD_SIZE];
+    size_t wanted = maxEntries < pJournal->count ? maxEntries : pJournal->count;
+
+    *pCount = 0;
+    if (wanted == 0) {
+        return ESP_OK;
+    }
+
+    // the wanted slots end right before the head and wrap at most once
+    int first = ((int)pJournal->head - (int)wanted + JOURNAL_SLOTS) % JOURNAL_SLOTS;
+    esp_err_t ret;
+    if (first < pJournal->head || pJournal->head == 0) {
+        ret = spi_25LC040_read_block(pJournal->devHandle, first * JOURNAL_RECORD_SIZE,
+                           &contents[first * JOURNAL_RECORD_SIZE], wanted * JOURNAL_RECORD_SIZE);
+    } else {
+        ret = spi_25LC040_read_block(pJournal->devHandle, 0x00, contents, pJournal->head * JOURNAL_RECORD_SIZE);
+        if (ret == ESP_OK)
+            ret = spi_25LC040_read_block(pJournal->devHandle, first * JOURNAL_RECORD_SIZE,
+                               &contents[first * JOURNAL_RECORD_SIZE], (JOURNAL_SLOTS - first) * JOURNAL_RECORD_SIZE);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    for (size_t i = 0; i < wanted; i++) {
+        int slot = ((int)pJournal->head - 1 - (int)i + JOURNAL_SLOTS) % JOURNAL_SLOTS;
+        if (journal_decode(&contents[slot * JOURNAL_RECORD_SIZE], &pEntries[*pCount]))
+            (*pCount)++;
+    }
+
+    return ESP_OK;
+}
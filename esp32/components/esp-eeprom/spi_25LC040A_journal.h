@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <driver/spi_master.h>
+
+// Circular access journal spread over the whole 25LC040A, one record per 16-byte page,
+// so every page takes 1/32 of the write cycles instead of page 0 taking them all
+#define JOURNAL_RECORD_SIZE 16
+#define JOURNAL_SLOTS (512 / JOURNAL_RECORD_SIZE)
+
+#define JOURNAL_DECISION_DENIED 0
+#define JOURNAL_DECISION_GRANTED 1
+
+typedef struct {
+    uint64_t serialNumber;
+    uint32_t sequence;
+    uint8_t decision;
+} eeprom_journal_entry_t;
+
+typedef struct {
+    spi_device_handle_t devHandle;
+    uint8_t head;             // slot the next record goes to
+    uint8_t count;            // valid records on the device
+    uint32_t nextSequence;
+} eeprom_journal_t;
+
+// Scans the device to find the newest record and resume after it
+esp_err_t eeprom_journal_init(eeprom_journal_t* pJournal, spi_device_handle_t devHandle);
+
+esp_err_t eeprom_journal_append(eeprom_journal_t* pJournal, uint64_t serialNumber, uint8_t decision);
+
+// Encodes the next record and takes its slot without writing it, for callers that write
+// it themselves (e.g. in the background). A record that never makes it to the device leaves
+// the slot with the record written there a lap earlier, still valid: readers see that old
+// record in its place, and the recovery resumes after the newest sequence number it finds.
+void eeprom_journal_next(eeprom_journal_t* pJournal, uint64_t serialNumber, uint8_t decision,
+                         uint16_t* pAddress, uint8_t pRecord[JOURNAL_RECORD_SIZE]);
+
+// Newest first, pCount receives the number of entries actually read
+esp_err_t eeprom_journal_read_last(eeprom_journal_t* pJournal, eeprom_journal_entry_t* pEntries,
+                                   size_t maxEntries, size_t* pCount);
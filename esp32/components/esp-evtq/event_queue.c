@@ -0,0 +1,270 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "event_queue.h"
+
+#define RECORD_MAGIC 0x5A
+#define RECORD_PENDING 0xFF
+#define RECORD_UPLOADED 0x00
+#define SECTOR_SIZE 4096
+
+typedef struct {
+    uint8_t magic;
+    uint8_t state;           // programmed from 0xFF to 0x00 once uploaded, no erase needed
+    uint8_t decision;
+    uint8_t readerId;
+    uint32_t sequence;
+    uint64_t serialNumber;
+    uint32_t bootId;         // first sequence number of the boot that recorded the event
+    uint32_t uptimeMs;
+    uint32_t reserved1;
+    uint32_t crc;            // everything but state and crc
+} event_record_t;
+
+_Static_assert(sizeof(event_record_t) == 32, "event records must tile the flash sectors");
+
+#define RECORDS_PER_SECTOR (SECTOR_SIZE / sizeof(event_record_t))
+
+static const char *TAG = "EVENT_QUEUE";
+
+static const esp_partition_t* partition;
+static SemaphoreHandle_t lock;
+
+static uint32_t slots;
+static uint32_t head;              // slot the next record goes to
+static uint32_t tail;              // oldest slot that may still be pending
+static uint32_t pending = 0;
+static uint32_t next_sequence = 0;
+static uint32_t boot_id;
+static uint32_t lost = 0;
+
+static uint32_t record_crc(const event_record_t* record)
+{
+    event_record_t copy = *record;
+    copy.state = 0;
+    return esp_rom_crc32_le(0, (const uint8_t*)&copy, offsetof(event_record_t, crc));
+}
+
+static bool record_valid(const event_record_t* record)
+{
+    return record->magic == RECORD_MAGIC && record->crc == record_crc(record);
+}
+
+static bool record_blank(const event_record_t* record)
+{
+    const uint8_t* bytes = (const uint8_t*)record;
+    for (size_t i = 0; i < sizeof(*record); i++) {
+        if (bytes[i] != 0xFF)
+            return false;
+    }
+    return true;
+}
+
+static esp_err_t read_record(uint32_t slot, event_record_t* record)
+{
+    return esp_partition_read(partition, slot * sizeof(event_record_t), record, sizeof(*record));
+}
+
+esp_err_t event_queue_init(void)
+{
+    lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, EVENT_QUEUE_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "Partition \"%s\" not found", EVENT_QUEUE_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    slots = partition->size / sizeof(event_record_t);
+    pending = 0;
+
+    // newest record gives the head, oldest pending one gives the tail
+    static event_record_t records[RECORDS_PER_SECTOR];
+    bool found = false, found_pending = false;
+    uint32_t newest = 0, oldest_pending = 0;
+    uint32_t newest_slot = 0, oldest_pending_slot = 0;
+
+    for (uint32_t sector = 0; sector < slots / RECORDS_PER_SECTOR; sector++) {
+        esp_err_t ret = esp_partition_read(partition, sector * SECTOR_SIZE, records, sizeof(records));
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        for (uint32_t i = 0; i < RECORDS_PER_SECTOR; i++) {
+            const event_record_t* record = &records[i];
+            uint32_t slot = sector * RECORDS_PER_SECTOR + i;
+            if (!record_valid(record))
+                continue;
+
+            if (!found || (int32_t)(record->sequence - newest) > 0) {
+                found = true;
+                newest = record->sequence;
+                newest_slot = slot;
+            }
+            if (record->state == RECORD_PENDING) {
+                pending++;
+                if (!found_pending || (int32_t)(record->sequence - oldest_pending) < 0) {
+                    found_pending = true;
+                    oldest_pending = record->sequence;
+                    oldest_pending_slot = slot;
+                }
+            }
+        }
+    }
+
+    head = found ? (newest_slot + 1) % slots : 0;
+    next_sequence = found ? newest + 1 : 0;
+    tail = found_pending ? oldest_pending_slot : head;
+    boot_id = next_sequence;
+
+    // a write torn by a power cut leaves a dirty slot, start over on the next sector
+    event_record_t record;
+    esp_err_t ret = read_record(head, &record);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (!record_blank(&record) && head % RECORDS_PER_SECTOR != 0) {
+        head = (head / RECORDS_PER_SECTOR + 1) * RECORDS_PER_SECTOR % slots;
+        if (pending == 0)
+            tail = head;
+    }
+
+    ESP_LOGI(TAG, "%lu events pending upload", (unsigned long)pending);
+    return ESP_OK;
+}
+
+// Makes room for the record at the head, dropping the oldest events if the sector is still in use
+static esp_err_t prepare_head(void)
+{
+    if (head % RECORDS_PER_SECTOR != 0) {
+        return ESP_OK;
+    }
+
+    // the queue went all the way around, the sector about to be erased holds the oldest events
+    if (pending > 0 && tail / RECORDS_PER_SECTOR == head / RECORDS_PER_SECTOR) {
+        uint32_t next_sector = (head + RECORDS_PER_SECTOR) % slots;
+        event_record_t record;
+        while (tail != next_sector) {
+            if (read_record(tail, &record) == ESP_OK && record_valid(&record) && record.state == RECORD_PENDING) {
+                pending--;
+                lost++;
+            }
+            tail = (tail + 1) % slots;
+        }
+        ESP_LOGW(TAG, "Queue full, %lu events lost so far", (unsigned long)lost);
+    }
+
+    return esp_partition_erase_range(partition, head * sizeof(event_record_t), SECTOR_SIZE);
+}
+
+esp_err_t event_queue_push(uint64_t serialNumber, bool access, uint8_t readerId)
+{
+    if (lock == NULL || partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    esp_err_t ret = prepare_head();
+    if (ret == ESP_OK) {
+        event_record_t record;
+        memset(&record, 0xFF, sizeof(record));
+        record.magic = RECORD_MAGIC;
+        record.state = RECORD_PENDING;
+        record.decision = access;
+        record.readerId = readerId;
+        record.sequence = next_sequence;
+        record.serialNumber = serialNumber;
+        record.bootId = boot_id;
+        record.uptimeMs = esp_timer_get_time() / 1000;
+        record.crc = record_crc(&record);
+
+        ret = esp_partition_write(partition, head * sizeof(event_record_t), &record, sizeof(record));
+        if (ret == ESP_OK) {
+            if (pending == 0)
+                tail = head;
+            pending++;
+            next_sequence++;
+        }
+        head = (head + 1) % slots;
+    }
+
+    xSemaphoreGive(lock);
+
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "Failed to store the event: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+size_t event_queue_peek(event_queue_entry_t* pEntries, size_t maxEntries)
+{
+    size_t count = 0;
+    if (lock == NULL || partition == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    event_record_t record;
+    for (uint32_t slot = tail; slot != head && count < maxEntries && count < pending; slot = (slot + 1) % slots) {
+        if (read_record(slot, &record) != ESP_OK || !record_valid(&record) || record.state != RECORD_PENDING)
+            continue;
+
+        event_queue_entry_t* entry = &pEntries[count++];
+        entry->serialNumber = record.serialNumber;
+        entry->sequence = record.sequence;
+        entry->access = record.decision != 0;
+        entry->readerId = record.readerId;
+        entry->ageKnown = record.bootId == boot_id;
+        entry->ageMs = entry->ageKnown ? now_ms - record.uptimeMs : 0;
+    }
+
+    xSemaphoreGive(lock);
+    return count;
+}
+
+esp_err_t event_queue_ack(uint32_t lastSequence)
+{
+    esp_err_t ret = ESP_OK;
+    if (lock == NULL || partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    event_record_t record;
+    const uint8_t uploaded = RECORD_UPLOADED;
+    while (pending > 0 && tail != head) {
+        if (read_record(tail, &record) == ESP_OK && record_valid(&record) && record.state == RECORD_PENDING) {
+            // pending records are in sequence order from the tail, the first newer one was not uploaded
+            if ((int32_t)(record.sequence - lastSequence) > 0)
+                break;
+            ret = esp_partition_write(partition, tail * sizeof(event_record_t) + offsetof(event_record_t, state),
+                                      &uploaded, sizeof(uploaded));
+            if (ret != ESP_OK)
+                break;
+            pending--;
+        }
+        tail = (tail + 1) % slots;
+    }
+
+    xSemaphoreGive(lock);
+    return ret;
+}
+
+size_t event_queue_pending(void)
+{
+    return pending;
+}
+
+uint32_t event_queue_lost(void)
+{
+    return lost;
+}
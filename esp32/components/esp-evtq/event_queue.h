@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Access events waiting to be uploaded to the dashboard, kept in the "evtq" flash
+// partition so they survive Wi-Fi outages and reboots. Records are appended
+// around the partition and marked uploaded in place; when the queue is full the
+// oldest sector is erased and its events are lost.
+
+#define EVENT_QUEUE_PARTITION "evtq"
+#define EVENT_QUEUE_READER_UNKNOWN 0xFF   // events queued before readers had ids
+
+typedef struct {
+    uint64_t serialNumber;
+    uint32_t sequence;
+    bool access;
+    uint8_t readerId;
+    bool ageKnown;           // false for events recorded before the last reboot
+    uint32_t ageMs;
+} event_queue_entry_t;
+
+esp_err_t event_queue_init(void);
+
+esp_err_t event_queue_push(uint64_t serialNumber, bool access, uint8_t readerId);
+
+// Oldest pending events first, returns how many were copied
+size_t event_queue_peek(event_queue_entry_t* pEntries, size_t maxEntries);
+
+// Marks the pending events up to lastSequence (the last one peeked and uploaded) as uploaded.
+// Events erased meanwhile to make room are gone already, newer ones stay pending.
+esp_err_t event_queue_ack(uint32_t lastSequence);
+
+size_t event_queue_pending(void);
+
+// Events erased before they could be uploaded, since boot
+uint32_t event_queue_lost(void);
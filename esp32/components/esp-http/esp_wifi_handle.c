@@ -2,25 +2,127 @@
 
 static const char *TAG = "ESP_WIFI";
 
+#define WIFI_CONNECTED_BIT BIT0
+
+#define AP_CACHE_NAMESPACE "wifi_ap"
+#define AP_CACHE_KEY "last"
+// failed attempts on the cached channel before scanning them all
+#define AP_CACHE_MAX_FAILURES 2
+
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_ap_cache_t;
+
+static StaticEventGroup_t wifi_events_buffer;
+static EventGroupHandle_t wifi_events = NULL;
+
+static esp_netif_t* sta_netif = NULL;
+static esp_netif_ip_info_t static_ip;
+static bool use_static_ip = false;
+
+static wifi_ap_cache_t ap_cache;
+static bool ap_pinned = false;       // connecting to the cached BSSID and channel only
+static int ap_failures = 0;
+static int64_t connect_start_us = 0;
+
+static void ap_cache_load(void)
+{
+    nvs_handle_t handle;
+    size_t size = sizeof(ap_cache);
+    if (nvs_open(AP_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return;
+    if (nvs_get_blob(handle, AP_CACHE_KEY, &ap_cache, &size) != ESP_OK || size != sizeof(ap_cache))
+        memset(&ap_cache, 0, sizeof(ap_cache));
+    nvs_close(handle);
+}
+
+static void ap_cache_store(const wifi_event_sta_connected_t* event)
+{
+    wifi_ap_cache_t cache = { 0 };
+    memcpy(cache.ssid, event->ssid, event->ssid_len < sizeof(cache.ssid) - 1 ? event->ssid_len : sizeof(cache.ssid) - 1);
+    memcpy(cache.bssid, event->bssid, sizeof(cache.bssid));
+    cache.channel = event->channel;
+
+    // only written when the AP changed, most connections cost no flash write
+    if (memcmp(&cache, &ap_cache, sizeof(cache)) == 0)
+        return;
+    ap_cache = cache;
+
+    nvs_handle_t handle;
+    if (nvs_open(AP_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+        return;
+    if (nvs_set_blob(handle, AP_CACHE_KEY, &ap_cache, sizeof(ap_cache)) == ESP_OK)
+        nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void ap_unpin(void)
+{
+    wifi_config_t config;
+    esp_wifi_get_config(WIFI_IF_STA, &config);
+    config.sta.bssid_set = false;
+    config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+    ap_pinned = false;
+}
+
 // Event handler for Wi-Fi
 static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data){
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        ap_failures = 0;
+#if WIFI_FAST_CONNECT
+        ap_cache_store((wifi_event_sta_connected_t*) event_data);
+#endif
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        xEventGroupClearBits(wifi_events, WIFI_CONNECTED_BIT);
+        // the AP moved to another channel or is gone, look for it on all of them
+        if (ap_pinned && ++ap_failures >= AP_CACHE_MAX_FAILURES) {
+            ESP_LOGW(TAG, "Cached AP not found on channel %u, scanning", ap_cache.channel);
+            ap_unpin();
+        }
         ESP_LOGI(TAG, "Trying to reconnect to the AP...");
+        connect_start_us = esp_timer_get_time();
         esp_wifi_connect();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "Connected successfully! Assigned IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        int64_t now = esp_timer_get_time();
+        ESP_LOGI(TAG, "Connected successfully! Assigned IP: " IPSTR " (%lld ms, %s, %s, %lld ms after boot)",
+                 IP2STR(&event->ip_info.ip), (now - connect_start_us) / 1000, ap_pinned ? "cached ap" : "scan",
+                 use_static_ip ? "static ip" : "dhcp", now / 1000);
+        xEventGroupSetBits(wifi_events, WIFI_CONNECTED_BIT);
     }
 }
 
+esp_err_t wifi_set_static_ip(const char* ip, const char* gateway, const char* netmask)
+{
+    if (esp_netif_str_to_ip4(ip, &static_ip.ip) != ESP_OK ||
+        esp_netif_str_to_ip4(gateway, &static_ip.gw) != ESP_OK ||
+        esp_netif_str_to_ip4(netmask, &static_ip.netmask) != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid static address %s/%s via %s, using DHCP", ip, netmask, gateway);
+        return ESP_ERR_INVALID_ARG;
+    }
+    use_static_ip = true;
+    return ESP_OK;
+}
+
 // Initialize Wi-Fi
 void wifi_init(char *ssid, char *password)
 {
+    wifi_events = xEventGroupCreateStatic(&wifi_events_buffer);
+
     esp_netif_init();
     esp_event_loop_create_default();
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
+
+    // no DHCP exchange before the first request
+    if (use_static_ip) {
+        esp_netif_dhcpc_stop(sta_netif);
+        esp_netif_set_ip_info(sta_netif, &static_ip);
+    }
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     esp_wifi_init(&cfg);
@@ -40,22 +142,64 @@ void wifi_init(char *ssid, char *password)
     strcpy((char*)wifi_config.sta.ssid, ssid);
     strcpy((char*)wifi_config.sta.password, password);
 
+#if WIFI_FAST_CONNECT
+    // only the cached channel is scanned, for the cached AP
+    ap_cache_load();
+    if (ap_cache.channel != 0 && strcmp(ap_cache.ssid, ssid) == 0) {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, ap_cache.bssid, sizeof(ap_cache.bssid));
+        wifi_config.sta.channel = ap_cache.channel;
+        ap_pinned = true;
+        ESP_LOGI(TAG, "Connecting to the cached AP on channel %u", ap_cache.channel);
+    }
+#endif
+
     esp_wifi_set_mode(WIFI_MODE_STA);
     esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-    
+
+    connect_start_us = esp_timer_get_time();
     esp_wifi_start();
 }
 
+bool wifi_wait_connected(TickType_t timeout)
+{
+    if (wifi_events == NULL) {
+        return false;
+    }
+    return xEventGroupWaitBits(wifi_events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, timeout) & WIFI_CONNECTED_BIT;
+}
+
+// TCP connections opened, used by the worker to tell reused connections apart
+static uint32_t connections = 0;
+
+// Shared between the caller and the worker, whoever finishes last releases it
+typedef struct {
+    bool in_use;
+    TaskHandle_t caller;      // NULL for fire-and-forget requests
+    bool done;
+    bool abandoned;
+    esp_err_t err;
+    int status;
+    int64_t enqueued_us;
+    size_t response_len;
+    bool overflow;            // the body did not fit in response, the rest was dropped
+    char response[HTTP_RESPONSE_MAX];
+    char url[HTTP_URL_MAX];
+    char post_data[HTTP_POST_MAX];
+} HttpRequestContext;
+
+// The client hands each request its own context as user_data, nothing is kept between
+// requests here and the body only goes to the fixed buffer of that context
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
-    static char *output_buffer;  // Buffer to store response of http request from event handler
-    static int output_len;       // Stores number of bytes read
+    HttpRequestContext* ctx = evt->user_data;
     switch(evt->event_id) {
         case HTTP_EVENT_ERROR:
             ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
             break;
         case HTTP_EVENT_ON_CONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            connections++;
             break;
         case HTTP_EVENT_HEADER_SENT:
             ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
@@ -65,46 +209,22 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-            /*
-             *  Check for chunked encoding is added as the URL for chunked encoding used in this example returns binary data.
-             *  However, event handler can also be used in case chunked encoding is used.
-             */
-            if (!esp_http_client_is_chunked_response(evt->client)) {
-                // If user_data buffer is configured, copy the response into the buffer
-                if (evt->user_data) {
-                    memcpy(evt->user_data + output_len, evt->data, evt->data_len);
-                } else {
-                    if (output_buffer == NULL) {
-                        output_buffer = (char *) malloc(esp_http_client_get_content_length(evt->client));
-                        output_len = 0;
-                        if (output_buffer == NULL) {
-                            ESP_LOGE(TAG, "Failed to allocate memory for output buffer");
-                            return ESP_FAIL;
-                        }
-                    }
-                    memcpy(output_buffer + output_len, evt->data, evt->data_len);
-                }
-                output_len += evt->data_len;
+            if (ctx == NULL)
+                break;
+            // one byte is kept for the terminator
+            if (ctx->response_len + evt->data_len < sizeof(ctx->response)) {
+                memcpy(ctx->response + ctx->response_len, evt->data, evt->data_len);
+                ctx->response_len += evt->data_len;
+                ctx->response[ctx->response_len] = '\0';
+            } else {
+                ctx->overflow = true;
             }
-
             break;
         case HTTP_EVENT_ON_FINISH:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
-            if (output_buffer != NULL) {
-                // Response is accumulated in output_buffer. Uncomment the below line to print the accumulated response
-                // ESP_LOG_BUFFER_HEX(TAG, output_buffer, output_len);
-                free(output_buffer);
-                output_buffer = NULL;
-            }
-            output_len = 0;
             break;
         case HTTP_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
-            if (output_buffer != NULL) {
-                free(output_buffer);
-                output_buffer = NULL;
-            }
-            output_len = 0;
             break;
         case HTTP_EVENT_REDIRECT:
             ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");
@@ -115,45 +235,354 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-void http_request_task(void *pvParameters)
+static portMUX_TYPE request_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t request_queue = NULL;
+static HttpRequestContext request_slots[HTTP_REQUEST_SLOTS];
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static http_client_stats_t stats;
+static uint32_t latency_window[HTTP_STATS_WINDOW]; // request latencies in us
+static uint32_t latency_count = 0;
+
+static void http_record_timing(uint32_t queued_us, uint32_t total_us, bool reused, bool ok)
 {
-    HttpRequestParams* p_params = (HttpRequestParams*)pvParameters;
+    taskENTER_CRITICAL(&stats_lock);
+    stats.requests++;
+    if (!ok)
+        stats.failures++;
+    if (reused)
+        stats.reused++;
+    latency_window[latency_count++ % HTTP_STATS_WINDOW] = total_us;
+    taskEXIT_CRITICAL(&stats_lock);
 
-    bool* p_access = p_params->p_access;
-    const char* url = p_params->url;
-    const char* post_data = p_params->post_data;
+    ESP_LOGD(TAG, "HTTP request: queued %lu us, total %lu us, %s connection",
+             (unsigned long)queued_us, (unsigned long)total_us, reused ? "reused" : "new");
+}
 
-    char local_response_buffer[6]; // Buffer to store response of http request
+static int compare_latency(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void http_client_get_stats(http_client_stats_t* pStats)
+{
+    uint32_t sorted[HTTP_STATS_WINDOW];
+
+    taskENTER_CRITICAL(&stats_lock);
+    *pStats = stats;
+    uint32_t count = latency_count < HTTP_STATS_WINDOW ? latency_count : HTTP_STATS_WINDOW;
+    memcpy(sorted, latency_window, count * sizeof(uint32_t));
+    taskEXIT_CRITICAL(&stats_lock);
+
+    pStats->connections = connections;
+    if (count == 0)
+        return;
+
+    qsort(sorted, count, sizeof(uint32_t), compare_latency);
+    pStats->p50_us = sorted[count / 2];
+    pStats->p99_us = sorted[(count * 99) / 100];
+    pStats->max_us = sorted[count - 1];
+}
 
+static HttpRequestContext* http_request_acquire(const char* url, const char* post_data)
+{
+    size_t url_len = strlen(url) + 1;
+    size_t post_len = strlen(post_data) + 1;
+
+    // url and post data are copied into the slot, they must outlive a timeout
+    if (url_len > HTTP_URL_MAX || post_len > HTTP_POST_MAX) {
+        ESP_LOGE(TAG, "HTTP request too large (url %u, data %u bytes)", (unsigned)url_len, (unsigned)post_len);
+        return NULL;
+    }
+
+    HttpRequestContext* ctx = NULL;
+    taskENTER_CRITICAL(&request_lock);
+    for (int i = 0; i < HTTP_REQUEST_SLOTS && ctx == NULL; i++) {
+        if (!request_slots[i].in_use) {
+            ctx = &request_slots[i];
+            ctx->in_use = true;
+        }
+    }
+    taskEXIT_CRITICAL(&request_lock);
+
+    if (ctx == NULL) {
+        ESP_LOGW(TAG, "All %d HTTP request slots busy", HTTP_REQUEST_SLOTS);
+        return NULL;
+    }
+
+    ctx->caller = NULL;
+    ctx->done = false;
+    ctx->abandoned = false;
+    ctx->err = ESP_OK;
+    ctx->status = 0;
+    ctx->response_len = 0;
+    ctx->overflow = false;
+    ctx->response[0] = '\0';
+    memcpy(ctx->url, url, url_len);
+    memcpy(ctx->post_data, post_data, post_len);
+    ctx->enqueued_us = esp_timer_get_time();
+    return ctx;
+}
+
+static void http_request_release(HttpRequestContext* ctx)
+{
+    taskENTER_CRITICAL(&request_lock);
+    ctx->in_use = false;
+    taskEXIT_CRITICAL(&request_lock);
+}
+
+static void http_complete(HttpRequestContext* ctx)
+{
+    taskENTER_CRITICAL(&request_lock);
+    bool abandoned = ctx->abandoned || ctx->caller == NULL;
+    TaskHandle_t caller = ctx->caller;
+    ctx->done = true;
+    taskEXIT_CRITICAL(&request_lock);
+
+    // the caller gave up waiting (or never did), nobody else will read the context
+    if (abandoned)
+        http_request_release(ctx);
+    else
+        xTaskNotifyGive(caller);
+}
+
+static esp_err_t http_perform_post(esp_http_client_handle_t client, HttpRequestContext* ctx)
+{
+    esp_http_client_set_url(client, ctx->url);
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+    ctx->response_len = 0;
+    ctx->overflow = false;
+    esp_http_client_set_user_data(client, ctx);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_post_field(client, ctx->post_data, strlen(ctx->post_data));
+    return esp_http_client_perform(client);
+}
+
+// Single long-lived task owning the connection to the dashboard
+static void http_worker_task(void *pvParameters)
+{
+    esp_http_client_handle_t client = NULL;
+    HttpRequestContext* ctx;
+    int64_t last_used_us = 0;
+
+    while (1) {
+        xQueueReceive(request_queue, &ctx, portMAX_DELAY);
+
+        int64_t start = esp_timer_get_time();
+        uint32_t connections_before = connections;
+
+        if (client == NULL) {
+            esp_http_client_config_t config = {
+                .url = ctx->url,
+                .event_handler = _http_event_handler,
+                .transport_type = HTTP_TRANSPORT_OVER_TCP,
+                .method = HTTP_METHOD_POST,
+            };
+            client = esp_http_client_init(&config);
+        } else if (start - last_used_us > (int64_t)HTTP_IDLE_CLOSE_MS * 1000) {
+            // the server may have dropped it meanwhile, a request written to it would be lost
+            esp_http_client_close(client);
+        }
+
+        // a request is only sent again when none of it reached the server: the connection
+        // could not be opened or the request could not be written. Once written the server may
+        // have handled it (a check or a log line), and a second one would be logged twice.
+        ctx->err = http_perform_post(client, ctx);
+        if (ctx->err == ESP_ERR_HTTP_CONNECT || ctx->err == ESP_ERR_HTTP_WRITE_DATA) {
+            esp_http_client_close(client);
+            ctx->err = http_perform_post(client, ctx);
+        }
+
+        if (ctx->err == ESP_OK) {
+            ctx->status = esp_http_client_get_status_code(client);
+            if (ctx->overflow)
+                ESP_LOGW(TAG, "HTTP response larger than %d bytes, truncated", HTTP_RESPONSE_MAX - 1);
+        } else {
+            ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(ctx->err));
+            esp_http_client_close(client);
+        }
+
+        if (!HTTP_REUSE_CONNECTION)
+            esp_http_client_close(client);
+
+        int64_t end = esp_timer_get_time();
+        last_used_us = end;
+        http_record_timing(start - ctx->enqueued_us, end - ctx->enqueued_us,
+                           connections == connections_before, ctx->err == ESP_OK && ctx->status == 200);
+
+        http_complete(ctx);
+
+        if (stats.requests % HTTP_STATS_WINDOW == 0) {
+            http_client_stats_t summary;
+            http_client_get_stats(&summary);
+            ESP_LOGI(TAG, "HTTP stats: %lu requests, %lu failed, %lu reused, %lu connections, p50 %lu us, p99 %lu us, max %lu us",
+                     (unsigned long)summary.requests, (unsigned long)summary.failures,
+                     (unsigned long)summary.reused, (unsigned long)summary.connections,
+                     (unsigned long)summary.p50_us, (unsigned long)summary.p99_us, (unsigned long)summary.max_us);
+        }
+    }
+}
+
+esp_err_t http_client_start(void)
+{
+    if (request_queue != NULL) {
+        return ESP_OK;
+    }
+
+    request_queue = xQueueCreate(HTTP_QUEUE_LENGTH, sizeof(HttpRequestContext*));
+    if (request_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(&http_worker_task, "http_worker", 8192, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+http_result_t http_post_request(const char* url, const char* post_data,
+                                char* response, size_t response_size, uint32_t timeout_ms)
+{
+    if (request_queue == NULL) {
+        return HTTP_RESULT_FAILED;
+    }
+
+    HttpRequestContext* ctx = http_request_acquire(url, post_data);
+    if (ctx == NULL) {
+        return HTTP_RESULT_FAILED;
+    }
+    ctx->caller = xTaskGetCurrentTaskHandle();
+
+    // drop notifications left over from earlier requests
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    if (xQueueSend(request_queue, &ctx, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        http_request_release(ctx);
+        return HTTP_RESULT_TIMEOUT;
+    }
+
+    bool done = false;
+    while (!done) {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t remaining = (int32_t)(deadline - now) > 0 ? deadline - now : 0;
+        bool notified = ulTaskNotifyTake(pdTRUE, remaining) > 0;
+
+        taskENTER_CRITICAL(&request_lock);
+        done = ctx->done;
+        if (!done && !notified)
+            ctx->abandoned = true;
+        taskEXIT_CRITICAL(&request_lock);
+
+        if (!done && !notified) {
+            ESP_LOGW(TAG, "HTTP POST timed out after %lu ms", (unsigned long)timeout_ms);
+            return HTTP_RESULT_TIMEOUT;
+        }
+    }
+
+    // a body the caller cannot hold whole is a failed request, never a truncated answer
+    http_result_t result = HTTP_RESULT_FAILED;
+    bool wanted = response != NULL && response_size > 0;
+    if (ctx->err == ESP_OK && ctx->status == 200) {
+        if (!wanted) {
+            result = HTTP_RESULT_OK;
+        } else if (!ctx->overflow && ctx->response_len < response_size) {
+            memcpy(response, ctx->response, ctx->response_len + 1);
+            result = HTTP_RESULT_OK;
+        } else {
+            ESP_LOGE(TAG, "HTTP response does not fit in %u bytes", (unsigned)response_size);
+        }
+    }
+
+    http_request_release(ctx);
+    return result;
+}
+
+esp_err_t http_post_async(const char* url, const char* post_data)
+{
+    if (request_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    HttpRequestContext* ctx = http_request_acquire(url, post_data);
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // the worker releases the context once the request is done
+    if (xQueueSend(request_queue, &ctx, 0) != pdTRUE) {
+        http_request_release(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_get_lines(const char* url, http_line_cb_t on_line, void* ctx)
+{
     esp_http_client_config_t config = {
         .url = url,
-        .event_handler = _http_event_handler,
-        .user_data = local_response_buffer,
         .transport_type = HTTP_TRANSPORT_OVER_TCP,
-        .method = HTTP_METHOD_POST,
+        .method = HTTP_METHOD_GET,
     };
     esp_http_client_handle_t client = esp_http_client_init(&config);
-    
-    // POST Request
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %lld",
-                esp_http_client_get_status_code(client),
-                esp_http_client_get_content_length(client));
-    } else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+        esp_http_client_cleanup(client);
+        return err;
     }
-    ESP_LOGI(TAG, "Received %c", local_response_buffer[0]);
-    ESP_LOGI(TAG, "Finished http example");
 
-    *p_access = local_response_buffer[0] == '1';
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200) {
+        ESP_LOGE(TAG, "HTTP GET Status = %d", status);
+        err = ESP_FAIL;
+    } else {
+        // the body is streamed, only one line is kept in memory at a time
+        char chunk[128];
+        char line[HTTP_LINE_MAX];
+        size_t line_len = 0;
+        bool overflow = false;
+        int len;
+        while ((len = esp_http_client_read(client, chunk, sizeof(chunk))) > 0) {
+            for (int i = 0; i < len; i++) {
+                if (chunk[i] == '\n' || chunk[i] == '\r') {
+                    if (line_len > 0 && !overflow) {
+                        line[line_len] = '\0';
+                        on_line(line, ctx);
+                    }
+                    line_len = 0;
+                    overflow = false;
+                } else if (line_len < sizeof(line) - 1) {
+                    line[line_len++] = chunk[i];
+                } else {
+                    overflow = true;
+                }
+            }
+        }
 
-    ESP_LOGI(TAG, "Access: %d", *p_access);
+        // a connection closed early also reads as the end of the body
+        if (len < 0) {
+            ESP_LOGE(TAG, "HTTP GET read failed");
+            err = ESP_FAIL;
+        } else if (!esp_http_client_is_complete_data_received(client)) {
+            ESP_LOGE(TAG, "HTTP GET body cut short");
+            err = ESP_FAIL;
+        } else if (line_len > 0 && !overflow) {
+            line[line_len] = '\0';
+            on_line(line, ctx);
+        }
+    }
 
+    esp_http_client_close(client);
     esp_http_client_cleanup(client);
-    vTaskDelete(NULL);
+    return err;
 }
 
 void init_nvs_partition(void)
@@ -165,11 +594,4 @@ void init_nvs_partition(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
-
-    // Erase NVS partition
-    ret = nvs_flash_erase_partition("nvs");
-    ESP_ERROR_CHECK(ret);
-
-    // Initialize NVS partition again
-    ESP_ERROR_CHECK(nvs_flash_init());
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_netif.h"
@@ -13,16 +15,32 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "sdkconfig.h"
 
-typedef struct {
-    bool* p_access;
-    const char* url;
-    const char* post_data;
-} HttpRequestParams;
+#include "http_request.h"
 
+// CONFIG_WIFI_FAST_CONNECT (menuconfig, "Access reader"), or WIFI_FAST_CONNECT=0 on the
+// command line, scans every channel for the AP on each connection instead, for comparison
+#ifndef WIFI_FAST_CONNECT
+#ifdef CONFIG_WIFI_FAST_CONNECT
+#define WIFI_FAST_CONNECT 1
+#else
+#define WIFI_FAST_CONNECT 0
+#endif
+#endif
+
+// Connects straight to the BSSID and channel of the last AP (kept in NVS) when it has the
+// same ssid, and falls back to a full scan if it is not found there
 void wifi_init(char *ssid, char *password);
 
-void http_request_task(void *pvParameters);
+// Optional, before wifi_init: fixed address instead of DHCP
+esp_err_t wifi_set_static_ip(const char* ip, const char* gateway, const char* netmask);
+
+// True once an IP address is assigned, waits up to timeout for it
+bool wifi_wait_connected(TickType_t timeout);
 
+// Keeps the NVS contents (Wi-Fi and PHY calibration data, cached AP, settings),
+// it is only erased when it cannot be used as is
 void init_nvs_partition(void);
\ No newline at end of file
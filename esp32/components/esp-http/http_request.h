@@ -0,0 +1,75 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Requests to the dashboard, served by one worker over a connection kept open between them.
+// Only needs esp_err.h, so code deciding scans can be built on the host as well.
+
+// Largest response body kept by http_post_request, including the terminator
+#define HTTP_RESPONSE_MAX 16
+
+// Largest url and post data of a request, including the terminator. Requests live in a
+// fixed pool of slots, so nothing is allocated per request.
+#define HTTP_URL_MAX 96
+#define HTTP_POST_MAX 2048
+#define HTTP_REQUEST_SLOTS 6
+
+// Requests waiting for the worker
+#define HTTP_QUEUE_LENGTH HTTP_REQUEST_SLOTS
+
+// Number of recent requests the latency percentiles are computed over
+#define HTTP_STATS_WINDOW 128
+
+// Set to 0 to open a new connection per request, for comparison
+#ifndef HTTP_REUSE_CONNECTION
+#define HTTP_REUSE_CONNECTION 1
+#endif
+
+// A connection idle this long is closed before the next request instead of reused, the
+// dashboard drops idle ones after 120 s (timeout_keep_alive in dashboard/main.py). A request
+// is retried only when nothing of it reached the server, so a dropped connection must not be
+// written to.
+#define HTTP_IDLE_CLOSE_MS 60000
+
+typedef struct {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t reused;          // requests served on an already open connection
+    uint32_t connections;     // TCP connections opened
+    uint32_t p50_us;          // latency from enqueue to response
+    uint32_t p99_us;
+    uint32_t max_us;
+} http_client_stats_t;
+
+typedef enum {
+    HTTP_RESULT_OK,
+    HTTP_RESULT_FAILED,
+    HTTP_RESULT_TIMEOUT,
+} http_result_t;
+
+// Longest line accepted by http_get_lines, longer lines are skipped
+#define HTTP_LINE_MAX 32
+
+typedef void (*http_line_cb_t)(const char* line, void* ctx);
+
+// Starts the worker that serves the requests below over one connection
+esp_err_t http_client_start(void);
+
+void http_client_get_stats(http_client_stats_t* pStats);
+
+// POST that returns as soon as the response arrives, or with HTTP_RESULT_TIMEOUT
+// once timeout_ms have passed. The response body is copied NUL terminated, a body that
+// does not fit in response_size (or HTTP_RESPONSE_MAX) makes the request fail.
+// Fails at once when the url or data are too long or every request slot is busy.
+http_result_t http_post_request(const char* url, const char* post_data,
+                                char* response, size_t response_size, uint32_t timeout_ms);
+
+// Fire-and-forget POST, the url and data are copied so the caller may return at once.
+// Shares the worker and its connection with http_post_request
+esp_err_t http_post_async(const char* url, const char* post_data);
+
+// GET request whose body is handed to on_line one line at a time. Fails when the body
+// ends before its length (or last chunk), after on_line has seen the lines received
+esp_err_t http_get_lines(const char* url, http_line_cb_t on_line, void* ctx);
@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "scan_link.h"
+
+#define SCAN_LINK_ATTEMPTS 2
+#define SCAN_LINK_BACKOFF_US (30 * 1000 * 1000)
+
+static const char *TAG = "SCAN_LINK";
+
+static int sock = -1;
+static uint32_t sequence = 0;
+static int64_t down_until_us = 0;
+static scan_link_stats_t stats;
+
+static void frame_encode(uint8_t* frame, uint8_t type, uint8_t decision, uint8_t readerId, uint32_t seq,
+                         uint64_t serialNumber)
+{
+    frame[0] = SCAN_LINK_MAGIC;
+    frame[1] = type;
+    frame[2] = decision;
+    frame[3] = readerId;
+    for (int i = 0; i < 4; i++)
+        frame[4 + i] = (uint8_t)(seq >> (8 * i));
+    for (int i = 0; i < 8; i++)
+        frame[8 + i] = (uint8_t)(serialNumber >> (8 * i));
+}
+
+static uint32_t frame_sequence(const uint8_t* frame)
+{
+    return frame[4] | (frame[5] << 8) | (frame[6] << 16) | ((uint32_t)frame[7] << 24);
+}
+
+static uint64_t frame_serial(const uint8_t* frame)
+{
+    uint64_t serialNumber = 0;
+    for (int i = 0; i < 8; i++)
+        serialNumber |= (uint64_t)frame[8 + i] << (8 * i);
+    return serialNumber;
+}
+
+esp_err_t scan_link_init(const char* serverIp, uint16_t port)
+{
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (inet_pton(AF_INET, serverIp, &server.sin_addr) != 1)
+        return ESP_ERR_INVALID_ARG;
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    // connected so only datagrams from the dashboard are received
+    if (connect(sock, (struct sockaddr*)&server, sizeof(server)) != 0) {
+        ESP_LOGE(TAG, "Failed to connect socket: errno %d", errno);
+        close(sock);
+        sock = -1;
+        return ESP_FAIL;
+    }
+
+    // numbering restarts at a random point every boot, so the first requests after a reboot
+    // are not taken by the dashboard for retries of the last ones before it
+    sequence = esp_random();
+
+    ESP_LOGI(TAG, "Access checks go to %s:%u", serverIp, port);
+    return ESP_OK;
+}
+
+esp_err_t scan_link_request(uint8_t readerId, uint64_t serialNumber, bool* pAccess, uint32_t timeoutMs)
+{
+    if (sock < 0 || esp_timer_get_time() < down_until_us)
+        return ESP_ERR_INVALID_STATE;
+
+    uint8_t frame[SCAN_LINK_FRAME_SIZE];
+    uint32_t seq = ++sequence;
+    frame_encode(frame, SCAN_LINK_REQUEST, 0, readerId, seq, serialNumber);
+    stats.requests++;
+
+    int64_t attempt_us = (int64_t)timeoutMs * 1000 / SCAN_LINK_ATTEMPTS;
+    for (int attempt = 0; attempt < SCAN_LINK_ATTEMPTS; attempt++) {
+        if (attempt > 0)
+            stats.retries++;
+
+        // the dashboard answers a repeated sequence number without logging it twice
+        if (send(sock, frame, sizeof(frame), 0) != sizeof(frame))
+            break;
+
+        int64_t deadline = esp_timer_get_time() + attempt_us;
+        int64_t remaining;
+        while ((remaining = deadline - esp_timer_get_time()) > 0) {
+            struct timeval tv = { .tv_sec = remaining / 1000000, .tv_usec = remaining % 1000000 };
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            uint8_t response[SCAN_LINK_FRAME_SIZE];
+            int len = recv(sock, response, sizeof(response), 0);
+            if (len < 0)
+                break;
+
+            // late answers to earlier requests are skipped, the card must match as well as the sequence
+            if (len == SCAN_LINK_FRAME_SIZE && response[0] == SCAN_LINK_MAGIC && response[1] == SCAN_LINK_RESPONSE &&
+                response[3] == readerId && frame_sequence(response) == seq && frame_serial(response) == serialNumber) {
+                *pAccess = response[2] == 1;
+                stats.answered++;
+                return ESP_OK;
+            }
+        }
+    }
+
+    stats.timeouts++;
+    down_until_us = esp_timer_get_time() + SCAN_LINK_BACKOFF_US;
+    ESP_LOGW(TAG, "No answer from the dashboard, using HTTP for %d s", SCAN_LINK_BACKOFF_US / 1000000);
+    return ESP_ERR_TIMEOUT;
+}
+
+scan_link_stats_t scan_link_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Access checks as fixed 16-byte UDP frames instead of JSON over HTTP.
+// Requests and responses share the layout below (little-endian); the dashboard answers
+// with the same reader id, sequence number and serial, and the decision filled in.
+// Sequence numbers start at a random value every boot, and a request is only taken for
+// a retry (answered again, not logged) when both its sequence and serial repeat.
+//
+//   0  magic       0xA5
+//   1  type        1 request, 2 response
+//   2  decision    0 denied, 1 granted (0 in requests)
+//   3  reader id
+//   4  sequence    uint32
+//   8  serial      uint64
+
+#define SCAN_LINK_FRAME_SIZE 16
+#define SCAN_LINK_MAGIC 0xA5
+#define SCAN_LINK_REQUEST 1
+#define SCAN_LINK_RESPONSE 2
+
+typedef struct {
+    uint32_t requests;
+    uint32_t answered;
+    uint32_t retries;
+    uint32_t timeouts;
+} scan_link_stats_t;
+
+esp_err_t scan_link_init(const char* serverIp, uint16_t port);
+
+// Sends one access check and waits up to timeoutMs for the answer, retrying once.
+// After a timeout the link is skipped for a while (ESP_ERR_INVALID_STATE) so callers
+// fall back to HTTP without paying the timeout on every scan. Not thread safe, called
+// from the decide stage only.
+esp_err_t scan_link_request(uint8_t readerId, uint64_t serialNumber, bool* pAccess, uint32_t timeoutMs);
+
+scan_link_stats_t scan_link_get_stats(void);
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include "acl_cache.h"
+
+#define LOOKUPS 1000000
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// xorshift64*, deterministic so runs are comparable
+static uint64_t rng_state = 0x9e3779b97f4a7c15u;
+static uint64_t next_serial(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    // RC522 serial numbers are 5 bytes wide
+    return (rng_state * 0x2545f4914f6cdd1du) & 0xffffffffffu;
+}
+
+static void bench(size_t size)
+{
+    uint64_t* serials = malloc(size * sizeof(uint64_t));
+    uint64_t* storage = malloc(size * sizeof(uint64_t));
+    uint64_t* probes = malloc(LOOKUPS * sizeof(uint64_t));
+    if (serials == NULL || storage == NULL || probes == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < size; i++)
+        serials[i] = next_serial();
+
+    // half of the probes are known cards
+    for (size_t i = 0; i < LOOKUPS; i++)
+        probes[i] = (i & 1) ? serials[next_serial() % size] : next_serial();
+
+    acl_cache_t cache;
+    acl_cache_init(&cache, storage, size);
+
+    uint64_t start = now_ns();
+    acl_cache_load(&cache, serials, size);
+    uint64_t load_ns = now_ns() - start;
+
+    size_t hits = 0;
+    start = now_ns();
+    for (size_t i = 0; i < LOOKUPS; i++)
+        hits += acl_cache_contains(&cache, probes[i]);
+    uint64_t lookup_ns = now_ns() - start;
+
+    // one delta worth of changes, removing and adding back the same cards
+    size_t changes = 1000;
+    start = now_ns();
+    for (size_t i = 0; i < changes; i++)
+        acl_cache_remove(&cache, serials[i]);
+    for (size_t i = 0; i < changes; i++)
+        acl_cache_insert(&cache, serials[i]);
+    uint64_t update_ns = now_ns() - start;
+
+    printf("%8zu %10.2f %12.1f %12.2f %8.1f%%\n",
+           cache.count, load_ns / 1e6, (double)lookup_ns / LOOKUPS,
+           (double)update_ns / (2 * changes) / 1e3, 100.0 * hits / LOOKUPS);
+
+    free(serials);
+    free(storage);
+    free(probes);
+}
+
+int main(void)
+{
+    printf("acl_cache: %d lookups per size\n", LOOKUPS);
+    printf("%8s %10s %12s %12s %9s\n", "cards", "load ms", "lookup ns", "update us", "hits");
+
+    size_t sizes[] = { 1000, 10000, 50000, 100000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench(sizes[i]);
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_clock.h"
+#include "sim_25LC040A.h"
+#include "spi_25LC040A_eeprom.h"
+#include "black_box.h"
+
+// Same wiring as esp32/main/rfid.c
+#define PIN_SPI_CLK 18
+#define PIN_SPI_MOSI 23
+#define PIN_SPI_MISO 19
+#define PIN_EEPROM_CS 16
+#define CLK_SPEED_HZ 1000000
+
+#define ITERATIONS 64
+
+static spi_device_handle_t spi_device;
+static uint8_t buffer[SIM_EEPROM_SIZE];
+static int over_budget = 0;
+
+typedef struct {
+    const char* name;
+    void (*setup)(void);
+    void (*run)(int iteration);
+    double max_transactions;        // per operation, 0 for no budget
+    double max_elapsed_us;
+} bench_case_t;
+
+static void read_sn_byte_by_byte(int iteration)
+{
+    (void)iteration;
+    for (int i = 15; i >= 0; i--)
+        spi_25LC040_read_byte(spi_device, i, &buffer[i]);
+}
+
+static void read_block_16(int iteration)
+{
+    spi_25LC040_read_block(spi_device, (iteration % 32) * 16, buffer, 16);
+}
+
+static void read_block_512(int iteration)
+{
+    (void)iteration;
+    spi_25LC040_read_block(spi_device, 0x00, buffer, SIM_EEPROM_SIZE);
+}
+
+static void write_byte(int iteration)
+{
+    spi_25LC040_write_enable(spi_device);
+    spi_25LC040_write_byte(spi_device, iteration % SIM_EEPROM_SIZE, iteration);
+}
+
+static void write_page(int iteration)
+{
+    spi_25LC040_write_enable(spi_device);
+    spi_25LC040_write_page(spi_device, (iteration % 32) * 16, buffer, 16);
+}
+
+static void write_block_unaligned(int iteration)
+{
+    (void)iteration;
+    spi_25LC040_write_block(spi_device, 0x1C, buffer, 40);
+}
+
+// What rc522_handler did per scan before the journal: page write, 100 ms delay, 16 byte reads
+static void baseline_black_box_update(int iteration)
+{
+    uint64_t sn = iteration;
+    memcpy(buffer, &sn, sizeof(sn));
+    spi_25LC040_write_enable(spi_device);
+    spi_25LC040_write_page(spi_device, 0x00, buffer, 16);
+    spi_25LC040_write_disable(spi_device);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    read_sn_byte_by_byte(iteration);
+}
+
+static void record_access(int iteration)
+{
+    black_box_record(0x1000000000ull + iteration, iteration & 1);
+}
+
+static void read_last_sn(int iteration)
+{
+    uint64_t sn = read_sn_eeprom();
+    (void)iteration;
+    (void)sn;
+}
+
+static void recover_black_box(int iteration)
+{
+    (void)iteration;
+    black_box_init(spi_device);
+}
+
+static void fill_black_box(void)
+{
+    for (int i = 0; i < 40; i++)
+        black_box_record(0x2000000000ull + i, true);
+}
+
+static const bench_case_t cases[] = {
+    { "read 16 B byte by byte", NULL, read_sn_byte_by_byte, 16, 0 },
+    { "read_block 16 B", NULL, read_block_16, 1, 0 },
+    { "read_block 512 B", NULL, read_block_512, 1, 0 },
+    { "write_byte", NULL, write_byte, 0, 5500 },
+    { "write_page 16 B", NULL, write_page, 0, 5500 },
+    { "write_block 40 B, 4 pages", NULL, write_block_unaligned, 0, 21000 },
+    { "baseline black box update", NULL, baseline_black_box_update, 0, 0 },
+    { "black box record", fill_black_box, record_access, 0, 5500 },
+    { "black box last sn", fill_black_box, read_last_sn, 1, 0 },
+    { "black box recovery", fill_black_box, recover_black_box, 1, 0 },
+};
+
+static void run_case(const bench_case_t* bench)
+{
+    sim_eeprom_reset();
+    black_box_init(spi_device);
+    if (bench->setup != NULL)
+        bench->setup();
+
+    sim_bus_stats_reset();
+    uint64_t start = sim_clock_now_us();
+    for (int i = 0; i < ITERATIONS; i++)
+        bench->run(i);
+    uint64_t elapsed = sim_clock_now_us() - start;
+    sim_bus_stats_t stats = sim_bus_stats();
+
+    double transactions = (double)stats.transactions / ITERATIONS;
+    double elapsed_us = (double)elapsed / ITERATIONS;
+    bool over = (bench->max_transactions > 0 && transactions > bench->max_transactions) ||
+                (bench->max_elapsed_us > 0 && elapsed_us > bench->max_elapsed_us);
+    over_budget += over;
+
+    printf("%-28s %8.1f %8.1f %8.1f %8.1f %10.1f %s\n", bench->name,
+           transactions, (double)stats.bytes / ITERATIONS, (double)stats.status_reads / ITERATIONS,
+           stats.bus_ns / 1000.0 / ITERATIONS, elapsed_us, over ? "OVER BUDGET" : "");
+}
+
+// Every page should take the same share of the write cycles
+static void report_wear(void)
+{
+    sim_eeprom_reset();
+    black_box_init(spi_device);
+    for (int i = 0; i < 32 * 100; i++)
+        black_box_record(i, true);
+
+    const uint32_t* writes = sim_eeprom_page_writes();
+    uint32_t min = writes[0], max = writes[0];
+    for (int page = 1; page < SIM_EEPROM_SIZE / SIM_EEPROM_PAGE_SIZE; page++) {
+        if (writes[page] < min)
+            min = writes[page];
+        if (writes[page] > max)
+            max = writes[page];
+    }
+    printf("\nwear after %d records: %" PRIu32 "..%" PRIu32 " write cycles per page\n", 32 * 100, min, max);
+    if (max - min > 1)
+        over_budget++;
+}
+
+// A protected array must stay untouched and the journal must survive a reboot
+static void report_consistency(void)
+{
+    sim_eeprom_reset();
+    black_box_init(spi_device);
+    for (int i = 0; i < 45; i++)
+        black_box_record(1000 + i, true);
+
+    black_box_init(spi_device);
+    uint64_t last = read_sn_eeprom();
+    printf("recovered last sn after reboot: %" PRIu64 " (%s)\n", last, last == 1044 ? "ok" : "WRONG");
+    over_budget += last != 1044;
+
+    spi_25LC040_write_enable(spi_device);
+    spi_25LC040_write_status(spi_device, 0x0C);
+    uint8_t before[SIM_EEPROM_SIZE];
+    memcpy(before, sim_eeprom_memory(), sizeof(before));
+    black_box_record(2000, true);
+    bool untouched = memcmp(before, sim_eeprom_memory(), sizeof(before)) == 0;
+    printf("write with the array protected: %s\n", untouched ? "ignored (ok)" : "WRITTEN");
+    over_budget += !untouched;
+}
+
+int main(void)
+{
+    spi_25LC040_init(VSPI_HOST, PIN_EEPROM_CS, PIN_SPI_CLK, PIN_SPI_MOSI, PIN_SPI_MISO, CLK_SPEED_HZ, &spi_device);
+
+    printf("25LC040A on a simulated %d kHz bus, %d operations per case, per-operation averages\n",
+           CLK_SPEED_HZ / 1000, ITERATIONS);
+    printf("%-28s %8s %8s %8s %8s %10s\n", "operation", "trans", "bytes", "polls", "bus us", "elapsed us");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        run_case(&cases[i]);
+
+    report_wear();
+    report_consistency();
+
+    // what the other devices on the bus (the RC522 readers) had to wait for
+    spi_25LC040_bus_stats_t bus = spi_25LC040_get_bus_stats();
+    uint64_t elapsed = sim_clock_now_us();
+    printf("bus held by the eeprom: %" PRIu32 " transactions, %" PRIu64 " us of %" PRIu64 " us (%.1f%%)\n",
+           bus.transactions, bus.busyUs, elapsed, elapsed ? 100.0 * bus.busyUs / elapsed : 0.0);
+
+    spi_25LC040_free(VSPI_HOST, spi_device);
+    return over_budget ? 1 : 0;
+}
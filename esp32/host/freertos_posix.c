@@ -0,0 +1,389 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+
+// FreeRTOS and esp_timer on POSIX threads, for the replay. Waits are on CLOCK_MONOTONIC,
+// the clock of sim_clock_posix.c, and priorities are left to the host scheduler.
+
+struct host_task {
+    TaskFunction_t function;
+    void* arg;
+    pthread_mutex_t mutex;
+    pthread_cond_t notified;
+    uint32_t notifications;
+};
+
+struct host_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    bool armed;
+    struct timespec deadline;
+};
+
+static __thread struct host_task* current_task = NULL;
+
+static void init_cond(pthread_cond_t* cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec deadline_after_us(uint64_t us)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += us / 1000000;
+    ts.tv_nsec += (us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+// Waits on cond until ready() holds or the ticks run out, with the mutex held; false on timeout
+static bool wait_until(pthread_cond_t* cond, pthread_mutex_t* mutex, TickType_t ticks,
+                       bool (*ready)(void*), void* ctx)
+{
+    if (ticks == portMAX_DELAY) {
+        while (!ready(ctx))
+            pthread_cond_wait(cond, mutex);
+        return true;
+    }
+
+    struct timespec deadline = deadline_after_us((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+    while (!ready(ctx)) {
+        if (pthread_cond_timedwait(cond, mutex, &deadline) == ETIMEDOUT)
+            return ready(ctx);
+    }
+    return true;
+}
+
+/* tasks */
+
+static void* task_main(void* arg)
+{
+    current_task = arg;
+    current_task->function(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackSize, void* arg,
+                       UBaseType_t priority, TaskHandle_t* pHandle)
+{
+    (void)name;
+    (void)stackSize;
+    (void)priority;
+
+    struct host_task* task = calloc(1, sizeof(*task));
+    if (task == NULL)
+        return pdFAIL;
+    task->function = function;
+    task->arg = arg;
+    pthread_mutex_init(&task->mutex, NULL);
+    init_cond(&task->notified);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+
+    if (pHandle != NULL)
+        *pHandle = task;
+    return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->mutex);
+    task->notifications++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->mutex);
+}
+
+static bool task_notified(void* ctx)
+{
+    return ((struct host_task*)ctx)->notifications > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout)
+{
+    struct host_task* task = current_task;
+
+    pthread_mutex_lock(&task->mutex);
+    wait_until(&task->notified, &task->mutex, timeout, task_notified, task);
+    uint32_t value = task->notifications;
+    if (value > 0)
+        task->notifications = clearOnExit ? 0 : value - 1;
+    pthread_mutex_unlock(&task->mutex);
+    return value;
+}
+
+/* queues and semaphores */
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage, StaticQueue_t* buffer)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    pthread_mutex_init(&buffer->mutex, NULL);
+    init_cond(&buffer->changed);
+    buffer->storage = storage;
+    buffer->length = length;
+    buffer->itemSize = itemSize;
+    return buffer;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    StaticQueue_t* queue = malloc(sizeof(*queue));
+    uint8_t* storage = itemSize > 0 ? malloc((size_t)length * itemSize) : NULL;
+    if (queue == NULL || (itemSize > 0 && storage == NULL)) {
+        free(queue);
+        free(storage);
+        return NULL;
+    }
+
+    xQueueCreateStatic(length, itemSize, storage, queue);
+    return queue;
+}
+
+static bool queue_has_room(void* ctx)
+{
+    QueueHandle_t queue = ctx;
+    return queue->count < queue->length;
+}
+
+static bool queue_has_item(void* ctx)
+{
+    return ((QueueHandle_t)ctx)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t timeout)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!wait_until(&queue->changed, &queue->mutex, timeout, queue_has_room, queue)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+
+    if (queue->itemSize > 0) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->storage + (size_t)tail * queue->itemSize, item, queue->itemSize);
+    }
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t timeout)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!wait_until(&queue->changed, &queue->mutex, timeout, queue_has_item, queue)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+
+    if (queue->itemSize > 0) {
+        memcpy(item, queue->storage + (size_t)queue->head * queue->itemSize, queue->itemSize);
+        queue->head = (queue->head + 1) % queue->length;
+    }
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+// A mutex is a queue of one empty item that starts full, a binary semaphore one that starts empty
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer)
+{
+    SemaphoreHandle_t semaphore = xQueueCreateStatic(1, 0, NULL, buffer);
+    xSemaphoreGive(semaphore);
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t semaphore = xQueueCreate(1, 0);
+    if (semaphore != NULL)
+        xSemaphoreGive(semaphore);
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer)
+{
+    return xQueueCreateStatic(1, 0, NULL, buffer);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+/* event groups */
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* buffer)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    pthread_mutex_init(&buffer->mutex, NULL);
+    init_cond(&buffer->changed);
+    return buffer;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    StaticEventGroup_t* group = malloc(sizeof(*group));
+    if (group == NULL)
+        return NULL;
+    xEventGroupCreateStatic(group);
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    group->bits |= bits;
+    EventBits_t value = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->mutex);
+    return value;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t value = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t value = group->bits;
+    pthread_mutex_unlock(&group->mutex);
+    return value;
+}
+
+typedef struct {
+    EventGroupHandle_t group;
+    EventBits_t bits;
+    bool all;
+} bits_wait_t;
+
+static bool bits_set(void* ctx)
+{
+    bits_wait_t* wait = ctx;
+    EventBits_t set = wait->group->bits & wait->bits;
+    return wait->all ? set == wait->bits : set != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t timeout)
+{
+    bits_wait_t wait = { group, bits, waitForAll };
+
+    pthread_mutex_lock(&group->mutex);
+    bool met = wait_until(&group->changed, &group->mutex, timeout, bits_set, &wait);
+    EventBits_t value = group->bits;
+    if (met && clearOnExit)
+        group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    return value;
+}
+
+/* one-shot timers, a thread each */
+
+static bool timer_due(struct host_timer* timer)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > timer->deadline.tv_sec ||
+           (now.tv_sec == timer->deadline.tv_sec && now.tv_nsec >= timer->deadline.tv_nsec);
+}
+
+static void* timer_main(void* arg)
+{
+    struct host_timer* timer = arg;
+
+    pthread_mutex_lock(&timer->mutex);
+    while (1) {
+        if (!timer->armed) {
+            pthread_cond_wait(&timer->changed, &timer->mutex);
+        } else if (!timer_due(timer)) {
+            pthread_cond_timedwait(&timer->changed, &timer->mutex, &timer->deadline);
+        } else {
+            timer->armed = false;
+            pthread_mutex_unlock(&timer->mutex);
+            timer->callback(timer->arg);
+            pthread_mutex_lock(&timer->mutex);
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* pHandle)
+{
+    struct host_timer* timer = calloc(1, sizeof(*timer));
+    if (timer == NULL)
+        return ESP_ERR_NO_MEM;
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    pthread_mutex_init(&timer->mutex, NULL);
+    init_cond(&timer->changed);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, timer_main, timer) != 0) {
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(thread);
+
+    *pHandle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs)
+{
+    pthread_mutex_lock(&timer->mutex);
+    bool armed = timer->armed;
+    if (!armed) {
+        timer->deadline = deadline_after_us(timeoutUs);
+        timer->armed = true;
+        pthread_cond_signal(&timer->changed);
+    }
+    pthread_mutex_unlock(&timer->mutex);
+    return armed ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->mutex);
+    bool armed = timer->armed;
+    timer->armed = false;
+    pthread_cond_signal(&timer->changed);
+    pthread_mutex_unlock(&timer->mutex);
+    return armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "http_request.h"
+
+// http_post_request of esp-http on plain sockets, for the replay: one connection to the
+// dashboard kept open between requests, served one at a time by the calling thread.
+
+#define HEADERS_MAX 1024
+
+static const char* TAG = "HTTP";
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int sock = -1;
+static char connected_to[HTTP_URL_MAX];
+
+typedef struct {
+    char host[64];
+    char port[8];
+    const char* path;
+} url_t;
+
+static bool url_parse(const char* text, url_t* url)
+{
+    if (strncmp(text, "http://", 7) != 0)
+        return false;
+    text += 7;
+
+    const char* path = strchr(text, '/');
+    const char* end = path != NULL ? path : text + strlen(text);
+    const char* colon = memchr(text, ':', end - text);
+    const char* host_end = colon != NULL ? colon : end;
+    if (host_end == text || (size_t)(host_end - text) >= sizeof(url->host))
+        return false;
+
+    memcpy(url->host, text, host_end - text);
+    url->host[host_end - text] = '\0';
+    if (colon != NULL && (size_t)(end - colon - 1) < sizeof(url->port) && end > colon + 1) {
+        memcpy(url->port, colon + 1, end - colon - 1);
+        url->port[end - colon - 1] = '\0';
+    } else {
+        strcpy(url->port, "80");
+    }
+    url->path = path != NULL ? path : "/";
+    return true;
+}
+
+static void disconnect(void)
+{
+    if (sock >= 0)
+        close(sock);
+    sock = -1;
+}
+
+static esp_err_t connect_to(const url_t* url, uint32_t timeout_ms)
+{
+    char key[sizeof(connected_to)];
+    snprintf(key, sizeof(key), "%s:%s", url->host, url->port);
+    // an idle connection the server closed reads as the end of the stream (or an error), it
+    // is replaced before anything is written to it
+    char peek;
+    if (sock >= 0 && strcmp(connected_to, key) == 0) {
+        ssize_t n = recv(sock, &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return ESP_OK;
+    }
+    disconnect();
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* addresses;
+    if (getaddrinfo(url->host, url->port, &hints, &addresses) != 0)
+        return ESP_FAIL;
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        freeaddrinfo(addresses);
+        return ESP_FAIL;
+    }
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    esp_err_t ret = connect(sock, addresses->ai_addr, addresses->ai_addrlen) == 0 ? ESP_OK : ESP_FAIL;
+    freeaddrinfo(addresses);
+    if (ret != ESP_OK) {
+        disconnect();
+        return ret;
+    }
+
+    snprintf(connected_to, sizeof(connected_to), "%s", key);
+    return ESP_OK;
+}
+
+static void keep_body(char* response, size_t response_size, size_t* kept, bool* overflow,
+                      const char* data, size_t size)
+{
+    if (response == NULL)
+        return;
+
+    size_t room = response_size - 1 - *kept;
+    size_t copy = size < room ? size : room;
+    memcpy(response + *kept, data, copy);
+    *kept += copy;
+    if (copy < size)
+        *overflow = true;
+}
+
+// Status and body of one response, the body is kept up to response_size - 1 bytes
+static http_result_t read_response(int* status, char* response, size_t response_size, bool* overflow)
+{
+    char headers[HEADERS_MAX + 1];
+    size_t len = 0;
+    char* body = NULL;
+
+    while (body == NULL) {
+        if (len == HEADERS_MAX)
+            return HTTP_RESULT_FAILED;
+        ssize_t n = recv(sock, headers + len, HEADERS_MAX - len, 0);
+        if (n <= 0)
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTP_RESULT_TIMEOUT : HTTP_RESULT_FAILED;
+        len += n;
+        headers[len] = '\0';
+        body = strstr(headers, "\r\n\r\n");
+    }
+    body += 4;
+
+    if (sscanf(headers, "HTTP/1.%*d %d", status) != 1)
+        return HTTP_RESULT_FAILED;
+
+    // uvicorn always sends the length, chunked bodies are not supported here
+    const char* length = strcasestr(headers, "\r\ncontent-length:");
+    if (length == NULL)
+        return HTTP_RESULT_FAILED;
+    size_t content_length = strtoul(length + 17, NULL, 10);
+
+    size_t have = len - (body - headers);
+    if (have > content_length)
+        have = content_length;
+
+    // copy what already arrived with the headers, then read the rest
+    size_t kept = 0;
+    *overflow = false;
+    keep_body(response, response_size, &kept, overflow, body, have);
+
+    char scratch[256];
+    while (have < content_length) {
+        size_t want = content_length - have < sizeof(scratch) ? content_length - have : sizeof(scratch);
+        ssize_t n = recv(sock, scratch, want, 0);
+        if (n <= 0)
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTP_RESULT_TIMEOUT : HTTP_RESULT_FAILED;
+        keep_body(response, response_size, &kept, overflow, scratch, n);
+        have += n;
+    }
+
+    if (response != NULL)
+        response[kept] = '\0';
+    return HTTP_RESULT_OK;
+}
+
+esp_err_t http_client_start(void)
+{
+    return ESP_OK;
+}
+
+http_result_t http_post_request(const char* url, const char* post_data,
+                                char* response, size_t response_size, uint32_t timeout_ms)
+{
+    url_t parsed;
+    if (!url_parse(url, &parsed) || strlen(url) >= HTTP_URL_MAX || strlen(post_data) >= HTTP_POST_MAX) {
+        ESP_LOGE(TAG, "HTTP request refused (%s)", url);
+        return HTTP_RESULT_FAILED;
+    }
+
+    char request[HEADERS_MAX + HTTP_POST_MAX];
+    int len = snprintf(request, sizeof(request),
+                       "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %zu\r\n\r\n%s", parsed.path, parsed.host, strlen(post_data), post_data);
+
+    pthread_mutex_lock(&lock);
+    http_result_t result = HTTP_RESULT_FAILED;
+    bool wanted = response != NULL && response_size > 0;
+
+    // sent again only when it could not be written, once written the server may have handled
+    // it and a second one would be logged twice (as in the firmware's worker)
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (connect_to(&parsed, timeout_ms) != ESP_OK)
+            break;
+
+        if (send(sock, request, len, MSG_NOSIGNAL) != len) {
+            disconnect();
+            continue;
+        }
+
+        int status = 0;
+        bool overflow = false;
+        result = read_response(&status, wanted ? response : NULL, response_size, &overflow);
+        if (result == HTTP_RESULT_OK && (status != 200 || (wanted && overflow)))
+            result = HTTP_RESULT_FAILED;
+        if (result != HTTP_RESULT_OK)
+            disconnect();
+        break;
+    }
+
+    pthread_mutex_unlock(&lock);
+    return result;
+}
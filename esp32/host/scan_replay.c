@@ -0,0 +1,391 @@
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sim_25LC040A.h"
+#include "spi_25LC040A_eeprom.h"
+#include "acl_store.h"
+#include "black_box.h"
+#include "event_queue.h"
+#include "feedback.h"
+#include "http_request.h"
+#include "scan_handlers.h"
+#include "scan_link.h"
+#include "scan_pipeline.h"
+#include "scan_recent.h"
+#include "sim_clock.h"
+
+// Replays the scans of an access log through the firmware's scan path (scan_handlers.c and the
+// pipeline) against a dashboard running locally, the RC522 events being the log lines paced by
+// their timestamps. The tasks are threads (freertos_posix.c), the EEPROM is simulated and the
+// flash partitions are in memory; the network and the dashboard are real.
+
+// Same wiring and settings as esp32/main/rfid.c
+#define PIN_SPI_CLK 18
+#define PIN_SPI_MOSI 23
+#define PIN_SPI_MISO 19
+#define PIN_EEPROM_CS 16
+#define CLK_SPEED_HZ 1000000
+
+#define PIN_GREEN_LED 4
+#define PIN_RED_LED 2
+#define PIN_BUZZER 33
+
+#define SCAN_REPEAT_WINDOW_MS 3000
+#define DEFAULT_READER_ID 1
+
+#define DRAIN_TIMEOUT_MS 30000
+
+typedef struct {
+    int64_t offsetUs;            // from the first line, once scaled
+    uint64_t serialNumber;
+    uint8_t readerId;
+} trace_scan_t;
+
+typedef enum {
+    STAGE_QUEUED,                // captured -> decide start
+    STAGE_DECIDE,
+    STAGE_DECISION,              // captured -> decided
+    STAGE_ACTUATE,
+    STAGE_PERSIST,
+    STAGE_RECORDED,              // captured -> persisted
+    STAGE_COUNT
+} replay_stage_t;
+
+typedef struct {
+    uint32_t* values;
+    size_t count;
+    size_t capacity;
+} samples_t;
+
+static const char* stage_names[STAGE_COUNT] = { "queued", "decide", "decision", "actuate", "persist", "recorded" };
+
+static pthread_mutex_t samples_lock = PTHREAD_MUTEX_INITIALIZER;
+static samples_t samples[STAGE_COUNT];
+static uint32_t granted, denied, cached, answered, failed;
+static int64_t last_decision_us;
+static bool full_feedback = false;
+
+static spi_device_handle_t spi_device;
+
+static void sample_add(replay_stage_t stage, int64_t us)
+{
+    samples_t* s = &samples[stage];
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 1024;
+        s->values = realloc(s->values, s->capacity * sizeof(uint32_t));
+    }
+    s->values[s->count++] = us > 0 ? (uint32_t)us : 0;
+}
+
+static bool replay_decide(scan_t* scan)
+{
+    int64_t start = esp_timer_get_time();
+    bool access = scan_decide(scan);
+    int64_t end = esp_timer_get_time();
+
+    pthread_mutex_lock(&samples_lock);
+    sample_add(STAGE_QUEUED, start - scan->capturedUs);
+    sample_add(STAGE_DECIDE, end - start);
+    sample_add(STAGE_DECISION, end - scan->capturedUs);
+    if (access)
+        granted++;
+    else
+        denied++;
+    if (scan->reported)
+        answered++;
+    else if (access && acl_store_contains(scan->serialNumber))
+        cached++;
+    else
+        failed++;
+    last_decision_us = end;
+    pthread_mutex_unlock(&samples_lock);
+    return access;
+}
+
+static void replay_actuate(const scan_t* scan)
+{
+    int64_t start = esp_timer_get_time();
+
+    // by default only the decision path is measured, the patterns last a second or more
+    if (full_feedback)
+        scan_actuate(scan);
+    else
+        feedback_play(scan->access ? FEEDBACK_GRANTED : FEEDBACK_DENIED);
+
+    pthread_mutex_lock(&samples_lock);
+    sample_add(STAGE_ACTUATE, esp_timer_get_time() - start);
+    pthread_mutex_unlock(&samples_lock);
+}
+
+static void replay_persist(const scan_t* scan)
+{
+    int64_t start = esp_timer_get_time();
+    scan_persist(scan);
+    int64_t end = esp_timer_get_time();
+
+    pthread_mutex_lock(&samples_lock);
+    sample_add(STAGE_PERSIST, end - start);
+    sample_add(STAGE_RECORDED, end - scan->capturedUs);
+    pthread_mutex_unlock(&samples_lock);
+}
+
+static const scan_pipeline_handlers_t replay_handlers = {
+    .decide = replay_decide,
+    .actuate = replay_actuate,
+    .persist = replay_persist
+};
+
+// "[dd/mm/YYYY HH:MM:SS] : Access granted (card number N[, reader R])", the dashboard's log lines
+static size_t load_trace(const char* path, trace_scan_t** pScans)
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    size_t count = 0, capacity = 0;
+    trace_scan_t* scans = NULL;
+    int64_t first = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        struct tm tm = { 0 };
+        char result[16];
+        uint64_t sn;
+        int consumed = 0;
+        if (sscanf(line, "[%d/%d/%d %d:%d:%d] : Access %15s (card number %" SCNu64 "%n", &tm.tm_mday, &tm.tm_mon,
+                   &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, result, &sn, &consumed) != 8)
+            continue;
+        tm.tm_mon -= 1;
+        tm.tm_year -= 1900;
+
+        unsigned reader = DEFAULT_READER_ID;
+        sscanf(line + consumed, ", reader %u", &reader);
+
+        int64_t when = (int64_t)timegm(&tm);
+        if (count == 0)
+            first = when;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            scans = realloc(scans, capacity * sizeof(trace_scan_t));
+        }
+        scans[count++] = (trace_scan_t) { (when - first) * 1000000, sn, (uint8_t)reader };
+    }
+
+    fclose(f);
+    *pScans = scans;
+    return count;
+}
+
+// Pacing: at speed times the pace of the log, idle gaps shortened to maxGapMs, or at a fixed rate
+static void schedule(trace_scan_t* scans, size_t count, double speed, double rate, uint32_t maxGapMs)
+{
+    int64_t previous = 0, at = 0;
+    for (size_t i = 0; i < count; i++) {
+        int64_t gap = scans[i].offsetUs - previous;
+        previous = scans[i].offsetUs;
+
+        if (rate > 0) {
+            at = (int64_t)(i * 1e6 / rate);
+        } else {
+            gap = gap < 0 ? 0 : (int64_t)(gap / speed);
+            at += gap < (int64_t)maxGapMs * 1000 ? gap : (int64_t)maxGapMs * 1000;
+        }
+        scans[i].offsetUs = at;
+    }
+}
+
+static esp_err_t load_access_list(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    acl_store_snapshot_begin();
+    char line[64];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char* end;
+        uint64_t sn = strtoull(line, &end, 10);
+        if (end != line)
+            acl_store_snapshot_add(sn);
+    }
+    fclose(f);
+    return acl_store_snapshot_commit(1);
+}
+
+static int compare_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void report_stage(replay_stage_t stage)
+{
+    samples_t* s = &samples[stage];
+    if (s->count == 0) {
+        printf("%-10s %8d\n", stage_names[stage], 0);
+        return;
+    }
+
+    qsort(s->values, s->count, sizeof(uint32_t), compare_u32);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < s->count; i++)
+        sum += s->values[i];
+
+    printf("%-10s %8zu %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu64 "\n", stage_names[stage],
+           s->count, s->values[s->count / 2], s->values[s->count * 90 / 100], s->values[s->count * 99 / 100],
+           s->values[s->count - 1], sum / s->count);
+}
+
+static bool drained(void)
+{
+    scan_stage_stats_t stats[SCAN_STAGE_COUNT];
+    scan_pipeline_get_stats(stats);
+    return stats[SCAN_STAGE_PERSIST].processed == stats[SCAN_STAGE_DECIDE].enqueued &&
+           stats[SCAN_STAGE_ACTUATE].processed == stats[SCAN_STAGE_DECIDE].enqueued;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-t trace] [-s server ip] [-p http port] [-u udp port | -U] [-a access list]\n"
+            "          [-x speed | -r scans/s] [-g max gap ms] [-f]\n"
+            "  -t  access log to replay (default ../../dashboard/LOGFILE)\n"
+            "  -s  dashboard address (default 127.0.0.1), -p its http port (default 80)\n"
+            "  -u  port of the udp access checks (default 4210), -U to check over http only\n"
+            "  -a  access list loaded into the local cache first, one serial number per line\n"
+            "  -x  times the pace of the log (default 60), -r fixed rate instead\n"
+            "  -g  longest gap between two scans once scaled (default 1000 ms)\n"
+            "  -f  wait for the led and buzzer patterns like the firmware does\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    const char* trace_path = "../../dashboard/LOGFILE";
+    const char* server = "127.0.0.1";
+    const char* acl_path = NULL;
+    int http_port = 80, udp_port = 4210;
+    double speed = 60, rate = 0;
+    uint32_t max_gap_ms = 1000;
+
+    // in order with the warnings on stderr when piped
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:p:u:Ua:x:r:g:fh")) != -1) {
+        switch (opt) {
+            case 't': trace_path = optarg; break;
+            case 's': server = optarg; break;
+            case 'p': http_port = atoi(optarg); break;
+            case 'u': udp_port = atoi(optarg); break;
+            case 'U': udp_port = 0; break;
+            case 'a': acl_path = optarg; break;
+            case 'x': speed = atof(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'g': max_gap_ms = atoi(optarg); break;
+            case 'f': full_feedback = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (speed <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    trace_scan_t* scans;
+    size_t count = load_trace(trace_path, &scans);
+    if (count == 0) {
+        fprintf(stderr, "No scans in %s\n", trace_path);
+        return 2;
+    }
+    schedule(scans, count, speed, rate, max_gap_ms);
+
+    // brought up as in rfid.c, on the stand-ins
+    sim_eeprom_reset();
+    spi_25LC040_init(VSPI_HOST, PIN_EEPROM_CS, PIN_SPI_CLK, PIN_SPI_MOSI, PIN_SPI_MISO, CLK_SPEED_HZ, &spi_device);
+    spi_25LC040_write_enable(spi_device);
+    spi_25LC040_write_status(spi_device, 0x00);
+    ESP_ERROR_CHECK(black_box_init(spi_device));
+
+    feedback_config_t feedback_config = {
+        .green_led_gpio = PIN_GREEN_LED,
+        .red_led_gpio = PIN_RED_LED,
+        .buzzer_gpio = PIN_BUZZER,
+        .buzzer_channel = LEDC_CHANNEL_0,
+        .buzzer_freq_hz = 2000,
+        .buzzer_resolution = LEDC_TIMER_13_BIT
+    };
+    ESP_ERROR_CHECK(feedback_init(&feedback_config));
+
+    ESP_ERROR_CHECK(acl_store_init());
+    if (acl_path != NULL && load_access_list(acl_path) != ESP_OK)
+        return 2;
+    ESP_ERROR_CHECK(event_queue_init());
+
+    static char access_url[HTTP_URL_MAX];
+    snprintf(access_url, sizeof(access_url), "http://%s:%d/check_access", server, http_port);
+    http_client_start();
+    if (udp_port != 0)
+        ESP_ERROR_CHECK(scan_link_init(server, udp_port));
+
+    // the repeat window shrinks with the log, so scans minutes apart are not taken for a card held on the reader
+    scan_recent_init(rate > 0 ? 0 : (uint32_t)(SCAN_REPEAT_WINDOW_MS / speed));
+    scan_handlers_init(access_url);
+    ESP_ERROR_CHECK(scan_pipeline_start(&replay_handlers));
+
+    printf("replaying %zu scans from %s over %.1f s against %s (%s%s)\n", count, trace_path,
+           scans[count - 1].offsetUs / 1e6, access_url, udp_port ? "udp first" : "http only",
+           full_feedback ? ", full feedback" : "");
+
+    int64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        int64_t wait = start + scans[i].offsetUs - esp_timer_get_time();
+        if (wait > 0)
+            sim_clock_advance_us(wait);
+        scan_capture(scans[i].readerId, scans[i].serialNumber, esp_timer_get_time());
+    }
+
+    int64_t deadline = esp_timer_get_time() + DRAIN_TIMEOUT_MS * 1000LL;
+    while (!drained() && esp_timer_get_time() < deadline)
+        vTaskDelay(1);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    scan_stage_stats_t stats[SCAN_STAGE_COUNT];
+    scan_pipeline_get_stats(stats);
+    scan_recent_stats_t recent = scan_recent_get_stats();
+    scan_link_stats_t link = scan_link_get_stats();
+    spi_25LC040_bus_stats_t bus = spi_25LC040_get_bus_stats();
+
+    pthread_mutex_lock(&samples_lock);
+    uint32_t decided = granted + denied;
+    double decision_s = (last_decision_us - start) / 1e6;
+    printf("scans      %zu captured, %" PRIu32 " repeats suppressed, %" PRIu32 " dropped, %" PRIu32 " decided in %.2f s\n",
+           count, recent.repeats, stats[SCAN_STAGE_DECIDE].dropped, decided, elapsed / 1e6);
+    printf("decisions  %.1f/s, %" PRIu32 " granted, %" PRIu32 " denied\n",
+           decision_s > 0 ? decided / decision_s : 0.0, granted, denied);
+    printf("answers    %" PRIu32 " by the dashboard (udp %" PRIu32 " of %" PRIu32 ", %" PRIu32 " timeouts), "
+           "%" PRIu32 " from the local list, %" PRIu32 " failed\n",
+           answered, link.answered, link.requests, link.timeouts, cached, failed);
+    printf("recorded   black box last sn %" PRIu64 ", %u events queued for upload, eeprom bus %" PRIu64 " us\n",
+           read_sn_eeprom(), (unsigned)event_queue_pending(), bus.busyUs);
+
+    printf("\n%-10s %8s %10s %10s %10s %10s %10s\n", "stage us", "count", "p50", "p90", "p99", "max", "mean");
+    for (int i = 0; i < STAGE_COUNT; i++)
+        report_stage(i);
+    pthread_mutex_unlock(&samples_lock);
+
+    if (!drained())
+        fprintf(stderr, "Pipeline not drained after %d ms\n", DRAIN_TIMEOUT_MS);
+    return failed > 0 || !drained() ? 1 : 0;
+}
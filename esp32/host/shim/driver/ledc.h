@@ -0,0 +1,52 @@
+#pragma once
+// Host stand-in for the LEDC (PWM) driver, the buzzer stays silent
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { LEDC_HIGH_SPEED_MODE = 0 } ledc_mode_t;
+typedef enum { LEDC_CHANNEL_0 = 0 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0 = 0 } ledc_timer_t;
+typedef enum { LEDC_TIMER_13_BIT = 13 } ledc_timer_bit_t;
+
+typedef struct {
+    ledc_timer_bit_t duty_resolution;
+    uint32_t freq_hz;
+    ledc_mode_t speed_mode;
+    ledc_timer_t timer_num;
+} ledc_timer_config_t;
+
+typedef struct {
+    ledc_channel_t channel;
+    uint32_t duty;
+    int gpio_num;
+    ledc_mode_t speed_mode;
+    ledc_timer_t timer_sel;
+} ledc_channel_config_t;
+
+static inline esp_err_t ledc_timer_config(const ledc_timer_config_t* config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+static inline esp_err_t ledc_channel_config(const ledc_channel_config_t* config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+static inline esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+    (void)mode;
+    (void)channel;
+    (void)duty;
+    return ESP_OK;
+}
+
+static inline esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+    (void)mode;
+    (void)channel;
+    return ESP_OK;
+}
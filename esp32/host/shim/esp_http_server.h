@@ -0,0 +1,54 @@
+#pragma once
+// Host stand-in for the ESP-IDF HTTP server, there is none: starting it fails
+
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef void* httpd_handle_t;
+
+typedef struct {
+    size_t stack_size;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() { .stack_size = 4096 }
+
+typedef struct httpd_req httpd_req_t;
+
+typedef enum {
+    HTTP_GET,
+} httpd_method_t;
+
+typedef struct {
+    const char* uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t* req);
+} httpd_uri_t;
+
+static inline esp_err_t httpd_start(httpd_handle_t* pHandle, const httpd_config_t* config)
+{
+    (void)pHandle;
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri)
+{
+    (void)handle;
+    (void)uri;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type)
+{
+    (void)req;
+    (void)type;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t httpd_resp_send(httpd_req_t* req, const char* buffer, size_t length)
+{
+    (void)req;
+    (void)buffer;
+    (void)length;
+    return ESP_ERR_NOT_SUPPORTED;
+}
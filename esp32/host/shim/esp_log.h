@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for the ESP-IDF logging macros, warnings and errors only unless HOST_LOG_VERBOSE is set
+
+#include <stdio.h>
+
+#ifdef HOST_LOG_VERBOSE
+#define ESP_LOGI(tag, format, ...) printf("I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) printf("D (%s) " format "\n", tag, ##__VA_ARGS__)
+#else
+// never printed, still checked and the arguments count as used
+#define ESP_LOGI(tag, format, ...) do { (void)(tag); if (0) printf(format, ##__VA_ARGS__); } while (0)
+#define ESP_LOGD(tag, format, ...) do { (void)(tag); if (0) printf(format, ##__VA_ARGS__); } while (0)
+#endif
+
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E (%s) " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOG_BUFFER_HEX(tag, buffer, length) do { (void)(tag); (void)(buffer); (void)(length); } while (0)
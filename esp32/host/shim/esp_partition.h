@@ -0,0 +1,26 @@
+#pragma once
+// Host stand-in for the partition API, partitions are kept in memory by sim_partition.c
+// with the sizes of esp32/partitions.csv and NOR flash semantics (erase to 0xFF, writes clear bits)
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    const char* label;
+    uint32_t size;
+    uint32_t erase_size;
+    uint8_t* data;
+} esp_partition_t;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label);
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size);
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size);
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+#include "sim_clock.h"
+
+static inline void esp_rom_delay_us(uint32_t us)
+{
+    sim_clock_advance_us(us);
+}
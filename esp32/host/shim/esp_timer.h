@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "sim_clock.h"
+
+static inline int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sim_clock_now_us();
+}
+
+// One-shot timers of freertos_posix.c, the callback runs on the timer's own thread
+typedef struct host_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    const char* name;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* pHandle);
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs);
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
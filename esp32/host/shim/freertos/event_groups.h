@@ -0,0 +1,27 @@
+#pragma once
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+
+typedef struct host_event_group {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    EventBits_t bits;
+} StaticEventGroup_t;
+
+typedef StaticEventGroup_t* EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* buffer);
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+
+// Returns the bits when the wait ended, whether or not the condition was met
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t timeout);
@@ -0,0 +1,25 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "sim_clock.h"
+
+typedef struct host_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    sim_clock_advance_us((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_clock_now_us() / (portTICK_PERIOD_MS * 1000));
+}
+
+// A detached thread, the stack size and priority are ignored
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackSize, void* arg,
+                       UBaseType_t priority, TaskHandle_t* pHandle);
+
+void xTaskNotifyGive(TaskHandle_t task);
+
+// Waits on the notification count of the calling task, which must have been created by xTaskCreate
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout);
@@ -0,0 +1,8 @@
+#pragma once
+// lwIP has the BSD socket API, the host's is used as is
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
@@ -0,0 +1,5 @@
+#pragma once
+// Host stand-in for the generated sdkconfig.h, the defaults of the project's Kconfig options
+
+#define CONFIG_SCAN_TRACE_ENABLED 1
+#define CONFIG_WIFI_FAST_CONNECT 1
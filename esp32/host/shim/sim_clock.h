@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+// Time shared by the shims. In the benchmarks it is simulated (sim_clock.c) and only moves
+// when the code under test waits or a simulated device spends time on the bus. The replay
+// links sim_clock_posix.c instead, where it is the monotonic clock and advancing it sleeps.
+uint64_t sim_clock_now_us(void);
+
+uint64_t sim_clock_now_ns(void);
+
+void sim_clock_advance_us(uint64_t us);
+
+void sim_clock_advance_ns(uint64_t ns);
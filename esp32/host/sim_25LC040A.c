@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include "driver/spi_master.h"
+#include "sim_clock.h"
+#include "sim_25LC040A.h"
+
+// 4-Kbit SPI Bus Serial EEPROM - p.7, TABLE 2-1: INSTRUCTION SET
+#define CMD_WRSR 0x01
+#define CMD_WRITE 0x02
+#define CMD_READ 0x03
+#define CMD_WRDI 0x04
+#define CMD_RDSR 0x05
+#define CMD_WREN 0x06
+
+// 4-Kbit SPI Bus Serial EEPROM - p.12, status register
+#define STATUS_WIP 0x01
+#define STATUS_WEL 0x02
+#define STATUS_BP 0x0C
+
+struct spi_device_t {
+    spi_host_device_t host;
+    uint8_t command_bits;
+    uint8_t address_bits;
+    bool half_duplex;
+    int clock_speed_hz;
+    transaction_cb_t pre_cb;
+    transaction_cb_t post_cb;
+};
+
+static bool bus_dma[SPI3_HOST + 1];
+static uint8_t memory[SIM_EEPROM_SIZE];
+static uint8_t status = 0;
+static uint64_t busy_until_ns = 0;
+static uint32_t write_cycle_us = SIM_DEFAULT_WRITE_CYCLE_US;
+static uint32_t overhead_ns = SIM_DEFAULT_TRANSACTION_OVERHEAD_NS;
+static uint32_t page_writes[SIM_EEPROM_SIZE / SIM_EEPROM_PAGE_SIZE];
+static sim_bus_stats_t stats;
+
+void sim_eeprom_reset(void)
+{
+    memset(memory, 0xFF, sizeof(memory));
+    memset(page_writes, 0, sizeof(page_writes));
+    status = 0;
+    busy_until_ns = 0;
+    sim_bus_stats_reset();
+}
+
+void sim_eeprom_set_write_cycle_us(uint32_t us)
+{
+    write_cycle_us = us;
+}
+
+void sim_eeprom_set_transaction_overhead_ns(uint32_t ns)
+{
+    overhead_ns = ns;
+}
+
+sim_bus_stats_t sim_bus_stats(void)
+{
+    return stats;
+}
+
+void sim_bus_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint8_t* sim_eeprom_memory(void)
+{
+    return memory;
+}
+
+const uint32_t* sim_eeprom_page_writes(void)
+{
+    return page_writes;
+}
+
+static bool busy(void)
+{
+    if (busy_until_ns != 0 && sim_clock_now_ns() >= busy_until_ns) {
+        // the latch is reset once the write cycle is over
+        status &= ~(STATUS_WIP | STATUS_WEL);
+        busy_until_ns = 0;
+    }
+    return status & STATUS_WIP;
+}
+
+static void start_write_cycle(void)
+{
+    status |= STATUS_WIP;
+    busy_until_ns = sim_clock_now_ns() + (uint64_t)write_cycle_us * 1000;
+    stats.write_cycles++;
+}
+
+// 4-Kbit SPI Bus Serial EEPROM - p.13, TABLE 2-3: ARRAY PROTECTION
+static bool is_protected(uint16_t address)
+{
+    switch ((status & STATUS_BP) >> 2) {
+        case 1: return address >= 0x180;
+        case 2: return address >= 0x100;
+        case 3: return true;
+        default: return false;
+    }
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t* bus_config, spi_common_dma_t dma_chan)
+{
+    (void)bus_config;
+    bus_dma[host_id] = dma_chan != SPI_DMA_DISABLED;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id)
+{
+    (void)host_id;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t* dev_config, spi_device_handle_t* handle)
+{
+    struct spi_device_t* device = calloc(1, sizeof(struct spi_device_t));
+    if (device == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    device->host = host_id;
+    device->command_bits = dev_config->command_bits;
+    device->address_bits = dev_config->address_bits;
+    device->half_duplex = dev_config->flags & SPI_DEVICE_HALFDUPLEX;
+    device->clock_speed_hz = dev_config->clock_speed_hz;
+    device->pre_cb = dev_config->pre_cb;
+    device->post_cb = dev_config->post_cb;
+    *handle = device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans)
+{
+    const spi_transaction_ext_t* ext = (const spi_transaction_ext_t*)trans;
+    uint8_t* rx = trans->rx_buffer;
+    size_t data_len = trans->length / 8;
+    size_t rx_len = trans->rxlength / 8;
+
+    // as the IDF driver: with DMA, a half-duplex transaction has a MOSI or a MISO data phase, not both
+    if (handle->half_duplex && bus_dma[handle->host] && data_len > 0 && rx_len > 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((data_len > 0 && trans->tx_buffer == NULL) || (rx_len > 0 && rx == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // command and address phases go out first, most significant bit first
+    size_t cmd_len = ((trans->flags & SPI_TRANS_VARIABLE_CMD) ? ext->command_bits : handle->command_bits) / 8;
+    size_t addr_len = ((trans->flags & SPI_TRANS_VARIABLE_ADDR) ? ext->address_bits : handle->address_bits) / 8;
+    uint8_t tx[8 + SIM_EEPROM_SIZE];
+    size_t tx_len = 0;
+    if (cmd_len + addr_len + data_len > sizeof(tx)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t i = 0; i < cmd_len; i++)
+        tx[tx_len++] = trans->cmd >> ((cmd_len - 1 - i) * 8);
+    for (size_t i = 0; i < addr_len; i++)
+        tx[tx_len++] = trans->addr >> ((addr_len - 1 - i) * 8);
+    if (data_len > 0)
+        memcpy(&tx[tx_len], trans->tx_buffer, data_len);
+    tx_len += data_len;
+
+    if (tx_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (handle->pre_cb != NULL)
+        handle->pre_cb(trans);
+
+    stats.transactions++;
+    stats.bytes += tx_len + rx_len;
+    uint64_t wire_ns = (uint64_t)(tx_len + rx_len) * 8 * 1000000000u / handle->clock_speed_hz;
+    stats.bus_ns += wire_ns;
+
+    // the command is decoded as the bits arrive, state changes happen when CS rises
+    uint8_t instruction = tx[0] & 0x07;
+    uint16_t address = (uint16_t)((tx[0] >> 3) & 0x01) << 8 | (tx_len > 1 ? tx[1] : 0);
+    bool is_busy = busy();
+
+    if (instruction == CMD_RDSR) {
+        stats.status_reads++;
+        if (rx_len > 0)
+            memset(rx, status, rx_len);
+    } else if (is_busy) {
+        // only RDSR is accepted during a write cycle
+        stats.ignored_commands++;
+        if (rx_len > 0)
+            memset(rx, 0xFF, rx_len);
+    } else if (instruction == CMD_READ) {
+        for (size_t i = 0; i < rx_len; i++)
+            rx[i] = memory[(address + i) % SIM_EEPROM_SIZE];
+    } else if (instruction == CMD_WREN) {
+        status |= STATUS_WEL;
+    } else if (instruction == CMD_WRDI) {
+        status &= ~STATUS_WEL;
+    } else if (instruction == CMD_WRITE) {
+        if (!(status & STATUS_WEL) || is_protected(address) || tx_len < 3) {
+            stats.ignored_commands++;
+            status &= ~STATUS_WEL;
+        } else {
+            // 4-Kbit SPI Bus Serial EEPROM - p.10, data wraps around inside the page
+            uint16_t page = address & ~(SIM_EEPROM_PAGE_SIZE - 1);
+            for (size_t i = 0; i < tx_len - 2; i++)
+                memory[page + ((address + i) % SIM_EEPROM_PAGE_SIZE)] = tx[2 + i];
+            page_writes[page / SIM_EEPROM_PAGE_SIZE]++;
+            start_write_cycle();
+        }
+    } else if (instruction == CMD_WRSR) {
+        if (!(status & STATUS_WEL) || tx_len < 2) {
+            stats.ignored_commands++;
+        } else {
+            status = (status & ~STATUS_BP) | (tx[1] & STATUS_BP);
+            start_write_cycle();
+        }
+    } else {
+        stats.ignored_commands++;
+    }
+
+    sim_clock_advance_ns(wire_ns + overhead_ns);
+    if (handle->post_cb != NULL)
+        handle->post_cb(trans);
+    return ESP_OK;
+}
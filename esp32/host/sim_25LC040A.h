@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Simulated 25LC040A behind the spi_device_polling_transmit shim.
+// Models the 512-byte array, page wrap-around, the status register (WIP, WEL,
+// block protection) and the internal write cycle, and accounts for bus usage.
+
+#define SIM_EEPROM_SIZE 512
+#define SIM_EEPROM_PAGE_SIZE 16
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;               // bytes clocked on the bus, both directions
+    uint64_t bus_ns;              // time the bus was busy
+    uint32_t status_reads;
+    uint32_t write_cycles;
+    uint32_t ignored_commands;    // sent while busy, without WEL or to a protected block
+} sim_bus_stats_t;
+
+// 4-Kbit SPI Bus Serial EEPROM - p.3, TWC max 5 ms
+#define SIM_DEFAULT_WRITE_CYCLE_US 5000
+
+// Software cost of a polling transaction on the ESP32 (set-up and wait), on top of the bits on the wire
+#define SIM_DEFAULT_TRANSACTION_OVERHEAD_NS 8000
+
+void sim_eeprom_reset(void);
+
+void sim_eeprom_set_write_cycle_us(uint32_t us);
+
+void sim_eeprom_set_transaction_overhead_ns(uint32_t ns);
+
+sim_bus_stats_t sim_bus_stats(void);
+
+void sim_bus_stats_reset(void);
+
+// Direct access to the array, bypassing the bus
+uint8_t* sim_eeprom_memory(void);
+
+// Write cycles each page went through since the last reset
+const uint32_t* sim_eeprom_page_writes(void);
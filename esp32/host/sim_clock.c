@@ -0,0 +1,23 @@
+#include "sim_clock.h"
+
+static uint64_t clock_ns = 0;
+
+uint64_t sim_clock_now_us(void)
+{
+    return clock_ns / 1000;
+}
+
+uint64_t sim_clock_now_ns(void)
+{
+    return clock_ns;
+}
+
+void sim_clock_advance_us(uint64_t us)
+{
+    clock_ns += us * 1000;
+}
+
+void sim_clock_advance_ns(uint64_t ns)
+{
+    clock_ns += ns;
+}
@@ -0,0 +1,38 @@
+#include <stdbool.h>
+#include <time.h>
+#include "sim_clock.h"
+
+// Counted from the first call, like esp_timer from boot
+static uint64_t start_ns = 0;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t sim_clock_now_ns(void)
+{
+    uint64_t now = monotonic_ns();
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&start_ns, &expected, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return now - __atomic_load_n(&start_ns, __ATOMIC_RELAXED);
+}
+
+uint64_t sim_clock_now_us(void)
+{
+    return sim_clock_now_ns() / 1000;
+}
+
+void sim_clock_advance_ns(uint64_t ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000ull, .tv_nsec = ns % 1000000000ull };
+    while (nanosleep(&ts, &ts) != 0)
+        ;
+}
+
+void sim_clock_advance_us(uint64_t us)
+{
+    sim_clock_advance_ns(us * 1000);
+}
@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <string.h>
+#include "esp_partition.h"
+
+// The data partitions of esp32/partitions.csv, in memory and empty at start
+#define SECTOR_SIZE 4096
+
+static uint8_t acl_data[0x10000];
+static uint8_t evtq_data[0x10000];
+
+static esp_partition_t partitions[] = {
+    { "acl", sizeof(acl_data), SECTOR_SIZE, acl_data },
+    { "evtq", sizeof(evtq_data), SECTOR_SIZE, evtq_data },
+};
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label)
+{
+    static bool erased = false;
+    (void)type;
+    (void)subtype;
+
+    // blank flash, as after flashing the app only
+    if (!erased) {
+        memset(acl_data, 0xFF, sizeof(acl_data));
+        memset(evtq_data, 0xFF, sizeof(evtq_data));
+        erased = true;
+    }
+
+    for (size_t i = 0; i < sizeof(partitions) / sizeof(partitions[0]); i++) {
+        esp_partition_t* partition = &partitions[i];
+        if (strcmp(partition->label, label) == 0)
+            return partition;
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size)
+{
+    if (offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, partition->data + offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size)
+{
+    if (offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+
+    // NOR flash, a write can only clear bits
+    const uint8_t* bytes = src;
+    for (size_t i = 0; i < size; i++)
+        partition->data[offset + i] &= bytes[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    if (offset % partition->erase_size != 0 || size % partition->erase_size != 0)
+        return ESP_ERR_INVALID_ARG;
+    if (offset + size > partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    memset(partition->data + offset, 0xFF, size);
+    return ESP_OK;
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "scan_trace.h"
+
+#define SCANS 1000000
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int main(void)
+{
+    // a stamp that only reads the clock and stores it, the scan stays open
+    uint32_t id = SCAN_TRACE_BEGIN(esp_timer_get_time());
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < SCANS; i++)
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_DECIDE_START);
+    uint64_t stamp_ns = now_ns() - start;
+
+    // whole scans as the pipeline traces them, the last stamp folds them into the histograms
+    start = now_ns();
+    for (uint32_t i = 0; i < SCANS; i++) {
+        id = SCAN_TRACE_BEGIN(esp_timer_get_time());
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_QUEUED);
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_DECIDE_START);
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_DECIDE_END);
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_ACTUATE_START);
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_PERSIST_START);
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_ACTUATE_END);
+        SCAN_TRACE_STAMP(id, SCAN_TRACE_PERSIST_END);
+    }
+    uint64_t scan_ns = now_ns() - start;
+
+    scan_trace_summary_t summary[SCAN_TRACE_INTERVAL_COUNT];
+    scan_trace_get(summary);
+
+    printf("scan_trace: %d scans, host clock\n", SCANS);
+    printf("%-28s %8.1f ns\n", "stamp", (double)stamp_ns / SCANS);
+    printf("%-28s %8.1f ns\n", "scan (begin, 7 stamps)", (double)scan_ns / SCANS);
+    printf("%-28s %8lu\n", "scans in the last windows", (unsigned long)summary[SCAN_TRACE_TOTAL].count);
+
+    return summary[SCAN_TRACE_TOTAL].count > 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <inttypes.h>
+#include "esp_log.h"
+#include "black_box.h"
+#include "spi_25LC040A_journal.h"
+#if BLACK_BOX_ASYNC
+#include "spi_25LC040A_async.h"
+
+#define READ_LOCK_TIMEOUT_MS 500
+#endif
+
+static const char* EEPROM_TAG = "eeprom";
+static eeprom_journal_t journal;
+
+#if BLACK_BOX_ASYNC
+static void record_written(esp_err_t result, void* ctx)
+{
+    if (result != ESP_OK)
+        ESP_LOGE(EEPROM_TAG, "Failed to store the access in the black box: %d", result);
+}
+
+// reads see every record submitted before them
+static esp_err_t read_begin(void)
+{
+    return spi_25LC040_async_lock(pdMS_TO_TICKS(READ_LOCK_TIMEOUT_MS));
+}
+
+static void read_end(void)
+{
+    spi_25LC040_async_unlock();
+}
+#else
+static esp_err_t read_begin(void)
+{
+    return ESP_OK;
+}
+
+static void read_end(void)
+{
+}
+#endif
+
+esp_err_t black_box_init(spi_device_handle_t devHandle)
+{
+    esp_err_t ret = eeprom_journal_init(&journal, devHandle);
+    if (ret != ESP_OK)
+        ESP_LOGE(EEPROM_TAG, "Failed to recover the black box: %d", ret);
+#if BLACK_BOX_ASYNC
+    else
+        ret = spi_25LC040_async_start(devHandle);
+#endif
+    return ret;
+}
+
+esp_err_t black_box_record(uint64_t serialNumber, bool access)
+{
+    uint8_t decision = access ? JOURNAL_DECISION_GRANTED : JOURNAL_DECISION_DENIED;
+#if BLACK_BOX_ASYNC
+    // the worker writes the page while the bus serves the readers, errors are logged by record_written
+    uint8_t record[JOURNAL_RECORD_SIZE];
+    uint16_t address;
+    eeprom_journal_next(&journal, serialNumber, decision, &address, record);
+    esp_err_t ret = spi_25LC040_write_block_async(address, record, sizeof(record), record_written, NULL);
+#else
+    esp_err_t ret = eeprom_journal_append(&journal, serialNumber, decision);
+#endif
+    if (ret != ESP_OK)
+        ESP_LOGE(EEPROM_TAG, "Failed to store the access in the black box: %d", ret);
+    return ret;
+}
+
+uint64_t read_sn_eeprom(void)
+{
+    eeprom_journal_entry_t last;
+    size_t count = 0;
+
+    if (read_begin() != ESP_OK)
+        return 0;
+    esp_err_t ret = eeprom_journal_read_last(&journal, &last, 1, &count);
+    read_end();
+
+    if (ret != ESP_OK || count == 0)
+        return 0;
+
+    return last.serialNumber;
+}
+
+void print_black_box(size_t entries)
+{
+    eeprom_journal_entry_t last[JOURNAL_SLOTS];
+    size_t count = 0;
+    if (entries > JOURNAL_SLOTS)
+        entries = JOURNAL_SLOTS;
+
+    esp_err_t ret = read_begin();
+    if (ret == ESP_OK) {
+        ret = eeprom_journal_read_last(&journal, last, entries, &count);
+        read_end();
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(EEPROM_TAG, "Failed to read the black box");
+        return;
+    }
+
+    ESP_LOGI(EEPROM_TAG, "Last %u accesses in the black box:", (unsigned)count);
+    for (size_t i = 0; i < count; i++)
+        ESP_LOGI(EEPROM_TAG, "#%" PRIu32 " %s (sn: %" PRIu64 ")", last[i].sequence,
+                 last[i].decision == JOURNAL_DECISION_GRANTED ? "granted" : "denied", last[i].serialNumber);
+}
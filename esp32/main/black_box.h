@@ -0,0 +1,22 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "spi_25LC040A_eeprom.h"
+
+// Records are written in the background by the esp-eeprom async writer, the host
+// benchmarks build with BLACK_BOX_ASYNC=0 to measure the synchronous path
+#ifndef BLACK_BOX_ASYNC
+#define BLACK_BOX_ASYNC 1
+#endif
+
+// Recovers the access journal kept in the EEPROM
+esp_err_t black_box_init(spi_device_handle_t devHandle);
+
+// Takes the next journal slot and queues the write, returns before it is on the device
+esp_err_t black_box_record(uint64_t serialNumber, bool access);
+
+// Serial number of the last access stored, 0 when the black box is empty
+uint64_t read_sn_eeprom(void);
+
+void print_black_box(size_t entries);
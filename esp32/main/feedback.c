@@ -0,0 +1,241 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "feedback.h"
+
+#define LED_GREEN 0x01
+#define LED_RED 0x02
+
+#define FEEDBACK_IDLE_BIT BIT0
+
+typedef struct {
+    uint8_t leds;
+    uint16_t buzzer_permille;    // buzzer duty cycle
+    uint16_t duration_ms;
+} feedback_step_t;
+
+typedef struct {
+    const feedback_step_t* steps;
+    uint8_t count;
+} feedback_sequence_t;
+
+static const feedback_step_t request_steps[] = {
+    { 0, 1000, 300 },
+};
+
+static const feedback_step_t granted_steps[] = {
+    { LED_GREEN, 1000, 1000 },
+};
+
+static const feedback_step_t denied_steps[] = {
+    { LED_RED, 800, 250 }, { LED_RED, 0, 250 },
+    { LED_RED, 800, 250 }, { LED_RED, 0, 250 },
+    { LED_RED, 800, 250 }, { LED_RED, 0, 250 },
+};
+
+static const feedback_sequence_t sequences[] = {
+    [FEEDBACK_OFF] = { NULL, 0 },
+    [FEEDBACK_REQUEST_PENDING] = { request_steps, sizeof(request_steps) / sizeof(request_steps[0]) },
+    [FEEDBACK_GRANTED] = { granted_steps, sizeof(granted_steps) / sizeof(granted_steps[0]) },
+    [FEEDBACK_DENIED] = { denied_steps, sizeof(denied_steps) / sizeof(denied_steps[0]) },
+};
+
+static const char *TAG = "FEEDBACK";
+
+static feedback_config_t cfg;
+
+// everything is allocated statically, nothing is created or freed per scan
+static StaticSemaphore_t lock_buffer;
+static SemaphoreHandle_t lock;
+static StaticEventGroup_t events_buffer;
+static EventGroupHandle_t events;
+static esp_timer_handle_t step_timer;
+static TaskHandle_t task;
+
+// Requests to the task, under the lock. The task is woken by a notification, which cannot
+// be lost the way a message to a full queue is: a step that never arrives would freeze the
+// pattern, and whoever waits for the feedback to end, forever.
+static bool play_requested = false;
+static feedback_pattern_t requested_pattern;
+static bool step_due = false;
+
+// only written by the feedback task, generation and armed_generation under the lock
+static const feedback_sequence_t* current = NULL;
+static uint8_t step = 0;
+static uint32_t generation = 0;           // bumped by each pattern played
+static uint32_t armed_generation = 0;     // pattern the step timer was started for
+
+static void feedback_output(uint8_t leds, uint16_t buzzer_permille)
+{
+    gpio_set_level(cfg.green_led_gpio, (leds & LED_GREEN) != 0);
+    gpio_set_level(cfg.red_led_gpio, (leds & LED_RED) != 0);
+
+    uint32_t duty = ((1u << cfg.buzzer_resolution) * buzzer_permille) / 1000;
+    ledc_set_duty(LEDC_HIGH_SPEED_MODE, cfg.buzzer_channel, duty);
+    ledc_update_duty(LEDC_HIGH_SPEED_MODE, cfg.buzzer_channel);
+}
+
+static void feedback_timer_cb(void* arg)
+{
+    (void)arg;
+
+    // the timer of a replaced pattern may still fire, its step is ignored
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (armed_generation == generation)
+        step_due = true;
+    xSemaphoreGive(lock);
+
+    xTaskNotifyGive(task);
+}
+
+static void feedback_start_step(void)
+{
+    if (current == NULL || step >= current->count) {
+        current = NULL;
+        feedback_output(0, 0);
+
+        // a pattern requested meanwhile already cleared the bit, it is not idle again
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (!play_requested)
+            xEventGroupSetBits(events, FEEDBACK_IDLE_BIT);
+        xSemaphoreGive(lock);
+        return;
+    }
+
+    const feedback_step_t* s = &current->steps[step];
+    feedback_output(s->leds, s->buzzer_permille);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    armed_generation = generation;
+    xSemaphoreGive(lock);
+    esp_timer_start_once(step_timer, (uint64_t)s->duration_ms * 1000);
+}
+
+static void feedback_task(void* arg)
+{
+    (void)arg;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // requests made since the last wake-up are folded, the last pattern played wins
+        xSemaphoreTake(lock, portMAX_DELAY);
+        bool play = play_requested;
+        feedback_pattern_t pattern = requested_pattern;
+        bool advance = step_due && !play;
+        play_requested = false;
+        step_due = false;
+        if (play)
+            generation++;
+        xSemaphoreGive(lock);
+
+        if (play) {
+            esp_timer_stop(step_timer);
+
+            current = &sequences[pattern];
+            step = 0;
+            feedback_start_step();
+        } else if (advance && current != NULL) {
+            step++;
+            feedback_start_step();
+        }
+    }
+}
+
+esp_err_t feedback_init(const feedback_config_t* config)
+{
+    cfg = *config;
+
+    gpio_config_t led_config = {
+        .pin_bit_mask = (1ULL << cfg.green_led_gpio) | (1ULL << cfg.red_led_gpio),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    esp_err_t ret = gpio_config(&led_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Configure the LEDC peripheral for PWM generation
+    ledc_timer_config_t ledc_timer = {
+        .duty_resolution = cfg.buzzer_resolution,
+        .freq_hz = cfg.buzzer_freq_hz,
+        .speed_mode = LEDC_HIGH_SPEED_MODE,
+        .timer_num = LEDC_TIMER_0
+    };
+    ledc_timer_config(&ledc_timer);
+
+    ledc_channel_config_t ledc_channel = {
+        .channel = cfg.buzzer_channel,
+        .duty = 0,
+        .gpio_num = cfg.buzzer_gpio,
+        .speed_mode = LEDC_HIGH_SPEED_MODE,
+        .timer_sel = LEDC_TIMER_0
+    };
+    ledc_channel_config(&ledc_channel);
+
+    feedback_output(0, 0);
+
+    lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+    events = xEventGroupCreateStatic(&events_buffer);
+    xEventGroupSetBits(events, FEEDBACK_IDLE_BIT);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = feedback_timer_cb,
+        .name = "feedback_step",
+    };
+    ret = esp_timer_create(&timer_args, &step_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (xTaskCreate(&feedback_task, "feedback_task", 2048, NULL, 6, &task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the feedback task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+// Called with the lock held. IDLE is cleared here and not when the task gets to the request,
+// so a wait right after the call cannot return on the bit of the previous pattern.
+static void request_play(feedback_pattern_t pattern)
+{
+    xEventGroupClearBits(events, FEEDBACK_IDLE_BIT);
+    requested_pattern = pattern;
+    play_requested = true;
+}
+
+esp_err_t feedback_play(feedback_pattern_t pattern)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    request_play(pattern);
+    xSemaphoreGive(lock);
+
+    xTaskNotifyGive(task);
+    return ESP_OK;
+}
+
+bool feedback_play_if_idle(feedback_pattern_t pattern)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool idle = xEventGroupGetBits(events) & FEEDBACK_IDLE_BIT;
+    if (idle)
+        request_play(pattern);
+    xSemaphoreGive(lock);
+
+    if (idle)
+        xTaskNotifyGive(task);
+    return idle;
+}
+
+bool feedback_wait_idle(TickType_t timeout)
+{
+    return xEventGroupWaitBits(events, FEEDBACK_IDLE_BIT, pdFALSE, pdTRUE, timeout) & FEEDBACK_IDLE_BIT;
+}
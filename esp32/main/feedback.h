@@ -0,0 +1,34 @@
+#pragma once
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/ledc.h"
+#include "esp_err.h"
+
+typedef enum {
+    FEEDBACK_OFF,
+    FEEDBACK_REQUEST_PENDING,
+    FEEDBACK_GRANTED,
+    FEEDBACK_DENIED,
+} feedback_pattern_t;
+
+typedef struct {
+    int green_led_gpio;
+    int red_led_gpio;
+    int buzzer_gpio;
+    ledc_channel_t buzzer_channel;
+    uint32_t buzzer_freq_hz;
+    ledc_timer_bit_t buzzer_resolution;
+} feedback_config_t;
+
+// Configures the LEDs and the buzzer once and starts the task that plays the patterns
+esp_err_t feedback_init(const feedback_config_t* config);
+
+// Returns at once, the pattern replaces whatever is playing. A feedback_wait_idle
+// after it waits for this pattern to end.
+esp_err_t feedback_play(feedback_pattern_t pattern);
+
+// Plays the pattern only when nothing is playing or requested, false otherwise
+bool feedback_play_if_idle(feedback_pattern_t pattern);
+
+// Blocks until the current pattern is over, false on timeout
+bool feedback_wait_idle(TickType_t timeout);
@@ -1,21 +1,36 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <esp_log.h>
 #include <inttypes.h>
 
 #include "rc522.h"
 #include "esp_wifi_handle.h"
 #include "spi_25LC040A_eeprom.h"
+#include "acl_store.h"
+#include "event_queue.h"
+#include "scan_link.h"
+#include "black_box.h"
 
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 
-#include "leds_utils.c"
+#include "feedback.h"
+#include "scan_handlers.h"
+#include "scan_pipeline.h"
+#include "scan_trace.h"
+#include "scan_recent.h"
+#include "settings.h"
+#include "startup.h"
 
 #define PIN_SPI_CLK 18
 #define PIN_SPI_MOSI 23
 #define PIN_SPI_MISO 19
 #define PIN_RC55_CS 5
+#define PIN_RC522_EXIT_CS 17
 #define PIN_EEPROM_CS 16
 #define CLK_SPEED_HZ 1000000
 
@@ -29,103 +44,262 @@
 
 #define WIFI_SSID "HUAWEI P smart 2019"
 #define WIFI_PASS "diogocorreia99"
-#define SERVER_IP "192.168.43.241"
-#define API_ENDPOINT "http://" SERVER_IP "/check_access"
+// defaults of the settings stored in NVS (settings.h)
+#define DEFAULT_SERVER_IP "192.168.43.241"
+#define DEFAULT_READER_ID 1
+#define DEFAULT_STATIC_IP ""            // e.g. "192.168.43.50", empty for DHCP
+#define DEFAULT_GATEWAY "192.168.43.1"
+#define DEFAULT_NETMASK "255.255.255.0"
+
+#define API_URL_MAX 64
+#define API_PATH "/check_access"
+#define API_LOG_BATCH_PATH "/log_access_batch"
+#define API_ACCESS_CHANGES_PATH "/access_changes?since="
+
+// scans of the same card closer than this are one presentation (card held on the reader)
+#define SCAN_REPEAT_WINDOW_MS 3000
+
+// every reader polls at this interval, their starts are staggered so the polls interleave on the bus
+#define RC522_SCAN_INTERVAL_MS 125
+#define RC522_TASK_PRIORITY 4
+#define READER_STATS_PERIOD 64
+
+// cold start, from power on to the readers polling with the network up
+#define BOOT_BUDGET_MS 5000
+
+#define BOOT_FEEDBACK BIT0
+#define BOOT_BLACK_BOX BIT1
+#define BOOT_SETTINGS BIT2
+#define BOOT_ACCESS_LIST BIT3
+#define BOOT_LOCAL_LIST BIT4        // a list was found in flash
+#define BOOT_EVENT_QUEUE BIT5
+#define BOOT_NETWORK BIT6
+#define BOOT_PIPELINE BIT7
+#define BOOT_READERS BIT8
+#define BOOT_ACL_SYNC BIT9
+#define BOOT_EVENT_UPLOAD BIT10
+
+#define SCAN_LINK_PORT 4210
+
+#define BLACK_BOX_PRINT_ENTRIES 5
+
+#define EVENT_BATCH_SIZE 16
+#define EVENT_UPLOAD_TIMEOUT_MS 5000
+#define EVENT_UPLOAD_RETRY_MS 10000
+
+// an up to date reader only gets "delta V" back, so the list can be polled often
+#define ACL_SYNC_PERIOD_MS 10000
+#define ACL_RETRY_PERIOD_MS 5000
+
+typedef enum {
+    ACL_SYNC_NONE,
+    ACL_SYNC_SNAPSHOT,
+    ACL_SYNC_DELTA,
+} acl_sync_kind_t;
+
+typedef struct {
+    acl_sync_kind_t kind;
+    uint32_t version;
+    long expected;      // lines announced after the first one, -1 when not sent
+    size_t lines;
+    size_t changes;
+    bool truncated;
+} acl_sync_t;
+
+typedef struct {
+    uint8_t id;                  // reported to the dashboard, the reader id setting plus the index
+    int csGpio;
+    rc522_handle_t scanner;
+    uint32_t scans;
+} reader_t;
+
+// one RC522 per chip select on the bus shared with the eeprom, the exit reader only on boards
+// that have it (CONFIG_RC522_EXIT_READER)
+static reader_t readers[] = {
+    { .csGpio = PIN_RC55_CS },
+#if CONFIG_RC522_EXIT_READER
+    { .csGpio = PIN_RC522_EXIT_CS },
+#endif
+};
+
+#define READER_COUNT (sizeof(readers) / sizeof(readers[0]))
+
+esp_err_t rc522_init(reader_t*, bool);
+esp_err_t readers_start(void);
+
+void acl_sync_task(void*);
+void event_upload_task(void*);
 
-#define red_on() turn_on_led(PIN_RED_LED)
-#define red_off() turn_off_led(PIN_RED_LED)
-#define green_on() turn_on_led(PIN_GREEN_LED)
-#define green_off() turn_off_led(PIN_GREEN_LED)
 
-esp_err_t rc522_init(bool);
-
-void turn_on_led(uint8_t);
-void turn_off_led(uint8_t);
+static const char* RC522_TAG = "rc522";
+static uint32_t reader_events = 0;
 
-void ledc_buzzer_init();
-void buzzer(float);
+spi_device_handle_t spi_device;
 
-bool request_access(uint64_t);
+static settings_t settings = {
+    .serverIp = DEFAULT_SERVER_IP,
+    .readerId = DEFAULT_READER_ID,
+    .staticIp = DEFAULT_STATIC_IP,
+    .gateway = DEFAULT_GATEWAY,
+    .netmask = DEFAULT_NETMASK,
+};
+static char api_url[API_URL_MAX];
+static char api_log_batch_url[API_URL_MAX];
+static char api_access_changes_url[API_URL_MAX];
 
-void request_seq();
-void access_seq();
-void forb_seq();
+static const char *WIFI_TAG = "wifi";
 
-uint64_t read_sn_eeprom(spi_device_handle_t, uint8_t);
+static const char* ACL_TAG = "acl";
 
-TaskHandle_t green_led_task_handle = NULL;
-TaskHandle_t red_led_task_handle = NULL;
+static const char* EVENT_TAG = "events";
 
-static const char* RC522_TAG = "rc522";
-static rc522_handle_t scanner;
+// The library polls each reader in its own task and does not expose the polls, the readers
+// get the same interval and priority and only their scans are counted here
+static void log_reader_stats(void)
+{
+    for (size_t i = 0; i < READER_COUNT; i++)
+        ESP_LOGI(RC522_TAG, "Reader %u: %lu scans", readers[i].id,
+                 (unsigned long)__atomic_load_n(&readers[i].scans, __ATOMIC_RELAXED));
+}
 
-static const char* EEPROM_TAG = "eeprom";
-spi_device_handle_t spi_device;
+static void reader_count_event(reader_t* reader)
+{
+    __atomic_add_fetch(&reader->scans, 1, __ATOMIC_RELAXED);
 
-static const char *WIFI_TAG = "wifi";
+    if (__atomic_add_fetch(&reader_events, 1, __ATOMIC_RELAXED) % READER_STATS_PERIOD == 0)
+        log_reader_stats();
+}
 
 static void rc522_handler(void* arg, esp_event_base_t base, int32_t event_id, void* event_data)
 {
+    reader_t* reader = (reader_t*) arg;
     rc522_event_data_t* data = (rc522_event_data_t*) event_data;
 
     switch(event_id) {
         case RC522_EVENT_TAG_SCANNED: {
+                int64_t captured_us = esp_timer_get_time();
                 rc522_tag_t* tag = (rc522_tag_t*) data->ptr;
                 uint64_t sn = tag->serial_number;
-
-                // print the serial number as hexadecimal
-                ESP_LOG_BUFFER_HEX(RC522_TAG, &sn, sizeof(sn));
-
-                ESP_LOGI(RC522_TAG, "Tag scanned (sn: %" PRIu64 ")", sn);
-
-                if (request_access(sn))
-                    access_seq();
-                else
-                    forb_seq();
-            
-                // store the serial number in the eeprom (black box)
-                uint8_t address = 0x00;
-                spi_25LC040_write_enable(spi_device);
-                spi_25LC040_write_page(spi_device, address, (uint16_t*)&sn, 16);
-                spi_25LC040_write_disable(spi_device);
-                
-                vTaskDelay(100 / portTICK_PERIOD_MS);
-
-                // read the stored serial number from the eeprom (black box)
-                uint64_t read_sn = read_sn_eeprom(spi_device, address);
-                ESP_LOGI(RC522_TAG, "Stored in the black box: %" PRIu64 "", read_sn);
+                reader_count_event(reader);
+                scan_capture(reader->id, sn, captured_us);
             }
             break;
     }
 }
 
-void app_main(void)
-{
-    /* buzzer */
-    ledc_buzzer_init();
+/* startup steps, each runs as soon as the ones it needs are ready */
+
+static esp_err_t start_feedback(void) {
+    /* leds and buzzer */
+    feedback_config_t feedback_config = {
+        .green_led_gpio = PIN_GREEN_LED,
+        .red_led_gpio = PIN_RED_LED,
+        .buzzer_gpio = PIN_BUZZER,
+        .buzzer_channel = BUZZER_CHANNEL,
+        .buzzer_freq_hz = BUZZER_FREQ_HZ,
+        .buzzer_resolution = BUZZER_RESOLUTION
+    };
+    return feedback_init(&feedback_config);
+}
 
-    /* eeprom */
+static esp_err_t start_black_box(void) {
+    /* eeprom, it also brings up the spi bus the readers attach to */
     spi_25LC040_init(VSPI_HOST, PIN_EEPROM_CS, PIN_SPI_CLK, PIN_SPI_MOSI, PIN_SPI_MISO, CLK_SPEED_HZ, &spi_device);
+    spi_25LC040_write_enable(spi_device);       // WRSR requires the write enable latch
     spi_25LC040_write_status(spi_device, 0x00); // disable write protection
+    esp_err_t ret = black_box_init(spi_device);
 
-    /* rc522 */
-    rc522_init(true); // true - attach to spi bus
+    /* read content of black box */
+    print_black_box(BLACK_BOX_PRINT_ENTRIES);
+    return ret;
+}
 
-    /* wifi */
+static esp_err_t start_settings(void) {
+    /* settings, kept in nvs with the wifi calibration and the last ap */
     init_nvs_partition();
+    esp_err_t ret = settings_load(&settings);
+    snprintf(api_url, sizeof(api_url), "http://%s" API_PATH, settings.serverIp);
+    snprintf(api_log_batch_url, sizeof(api_log_batch_url), "http://%s" API_LOG_BATCH_PATH, settings.serverIp);
+    snprintf(api_access_changes_url, sizeof(api_access_changes_url), "http://%s" API_ACCESS_CHANGES_PATH, settings.serverIp);
+    for (size_t i = 0; i < READER_COUNT; i++)
+        readers[i].id = settings.readerId + i;
+    return ret;
+}
+
+static esp_err_t start_access_list(void) {
+    /* access list cache, a list found in flash is enough to decide scans offline */
+    esp_err_t ret = acl_store_init();
+    if (acl_store_is_ready())
+        startup_set_ready(BOOT_LOCAL_LIST);
+    return ret;
+}
+
+static esp_err_t start_event_queue(void) {
+    /* events waiting for the dashboard */
+    return event_queue_init();
+}
+
+static esp_err_t start_network(void) {
+    /* wifi, ready once an address is assigned */
+    if (settings.staticIp[0] != '\0')
+        wifi_set_static_ip(settings.staticIp, settings.gateway, settings.netmask);
     wifi_init(WIFI_SSID, WIFI_PASS);
+    http_client_start();
+    scan_link_init(settings.serverIp, SCAN_LINK_PORT);
+    scan_trace_http_start(); // GET /trace
 
-    /* read content of black box */
-    uint8_t address = 0x00;
-    uint64_t read_sn = read_sn_eeprom(spi_device, address);
-    ESP_LOGI(RC522_TAG, "Stored in the black box: %" PRIu64 "", read_sn);
+    wifi_wait_connected(portMAX_DELAY);
+    return ESP_OK;
+}
+
+static esp_err_t start_pipeline(void) {
+    /* scan processing */
+    scan_recent_init(SCAN_REPEAT_WINDOW_MS);
+    scan_handlers_init(api_url);
+    return scan_pipeline_start(&scan_handlers);
+}
+
+static esp_err_t start_acl_sync(void) {
+    return xTaskCreate(&acl_sync_task, "acl_sync_task", 4096, NULL, 4, NULL) == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t start_event_upload(void) {
+    TaskHandle_t task;
+    if (xTaskCreate(&event_upload_task, "event_upload_task", 4096, NULL, 3, &task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    scan_handlers_set_upload_task(task);
+    return ESP_OK;
+}
+
+// Wi-Fi associates while the peripherals come up and the black box is recovered, the readers
+// start polling once scans can be decided (a stored list or the network) and recorded
+static const startup_step_t startup_steps[] = {
+    { "feedback", BOOT_FEEDBACK, 0, 0, start_feedback, 3072 },
+    { "black_box", BOOT_BLACK_BOX, 0, 0, start_black_box, 4096 },
+    { "settings", BOOT_SETTINGS, 0, 0, start_settings, 3072 },
+    { "access_list", BOOT_ACCESS_LIST, 0, 0, start_access_list, 3072 },
+    { "event_queue", BOOT_EVENT_QUEUE, 0, 0, start_event_queue, 3072 },
+    { "network", BOOT_NETWORK, BOOT_SETTINGS, 0, start_network, 4096 },
+    { "pipeline", BOOT_PIPELINE, BOOT_FEEDBACK | BOOT_BLACK_BOX | BOOT_SETTINGS | BOOT_EVENT_QUEUE,
+      BOOT_LOCAL_LIST | BOOT_NETWORK, start_pipeline, 3072 },
+    { "readers", BOOT_READERS, BOOT_BLACK_BOX | BOOT_PIPELINE, 0, readers_start, 4096 },
+    { "acl_sync", BOOT_ACL_SYNC, BOOT_ACCESS_LIST | BOOT_NETWORK, 0, start_acl_sync, 2048 },
+    { "event_upload", BOOT_EVENT_UPLOAD, BOOT_EVENT_QUEUE | BOOT_NETWORK, 0, start_event_upload, 2048 },
+};
+
+void app_main(void)
+{
+    startup_run(startup_steps, sizeof(startup_steps) / sizeof(startup_steps[0]), BOOT_BUDGET_MS);
 }
 
-esp_err_t rc522_init(bool attach_to_bus) {
+esp_err_t rc522_init(reader_t* reader, bool attach_to_bus) {
     rc522_config_t config = {
         .spi.host = VSPI_HOST,
-        .spi.sda_gpio = PIN_RC55_CS,
-        .spi.bus_is_initialized = attach_to_bus
+        .spi.sda_gpio = reader->csGpio,
+        .spi.bus_is_initialized = attach_to_bus,
+        .scan_interval_ms = RC522_SCAN_INTERVAL_MS,
+        .task_priority = RC522_TASK_PRIORITY     // the same for all readers, they share the cpu evenly
     };
 
     if (!attach_to_bus) {
@@ -134,140 +308,170 @@ esp_err_t rc522_init(bool attach_to_bus) {
         config.spi.miso_gpio = PIN_SPI_MISO;
     }
     
-    esp_err_t ret = rc522_create(&config, &scanner);
+    esp_err_t ret = rc522_create(&config, &reader->scanner);
     if (ret != ESP_OK) {
-        ESP_LOGE(RC522_TAG, "Failed to create scanner: %d", ret);
+        ESP_LOGE(RC522_TAG, "Failed to create scanner %u: %d", reader->id, ret);
         return ret;
     }
 
-    ret = rc522_register_events(scanner, RC522_EVENT_ANY, rc522_handler, NULL);
+    ret = rc522_register_events(reader->scanner, RC522_EVENT_ANY, rc522_handler, reader);
     if (ret != ESP_OK) {
-        ESP_LOGE(RC522_TAG, "Failed to register events: %d", ret);
-        return ret;
-    }
-
-    ret = rc522_start(scanner);
-    if (ret != ESP_OK) {
-        ESP_LOGE(RC522_TAG, "Failed to start scanner: %d", ret);
+        ESP_LOGE(RC522_TAG, "Failed to register events of scanner %u: %d", reader->id, ret);
         return ret;
     }
 
     return ret;
 }
 
-uint64_t read_sn_eeprom(spi_device_handle_t spi_device, uint8_t address) {
-    uint8_t read_data;
-    uint64_t read_sn = 0;
-    for (int i = 15; i >= 0; i--) {
-        spi_25LC040_read_byte(spi_device, address + i, &read_data);
-        read_sn |= (uint64_t) read_data << (i * 8);
-    }
-    return read_sn;
-}
-
-bool request_access(uint64_t serial_number) {
-    request_seq();
-
-    char sn_str[64];
-    snprintf(sn_str, sizeof(sn_str), "%" PRIu64, serial_number);
-    char post_data[100];
-    snprintf(post_data, sizeof(post_data), "{\"sn\":\"%s\"}", sn_str);
-    
-    bool access = false;
-    HttpRequestParams params = {
-        .p_access = &access,
-        .url = API_ENDPOINT,
-        .post_data = post_data
-    };
-
-    xTaskCreate(&http_request_task, "http_request_task", 8192, (void*)&params, 5, NULL);
-    
-    // task is asynchronous, wait some time for it to finish
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-
-    if (access)
-        ESP_LOGI(RC522_TAG, "Access granted.");
-    else
-        ESP_LOGI(RC522_TAG, "Access denied.");
-
-    return access;
-}
-
-void request_seq() {
-    buzzer(1);
+esp_err_t readers_start(void) {
+    esp_err_t ret = ESP_OK;
 
-    vTaskDelay(300 / portTICK_PERIOD_MS);
+    for (size_t i = 0; i < READER_COUNT; i++) {
+        esp_err_t err = rc522_init(&readers[i], true); // true - attach to spi bus
+        if (err != ESP_OK)
+            ret = err;
+    }
 
-    buzzer(0);
-}
+    // spread the first polls over one interval, so the readers take turns on the bus instead of
+    // all polling at once and waiting for each other
+    for (size_t i = 0; i < READER_COUNT; i++) {
+        if (readers[i].scanner == NULL)
+            continue;
 
-void access_seq() {
-    green_on();
-    buzzer(1);
+        esp_err_t err = rc522_start(readers[i].scanner);
+        if (err != ESP_OK) {
+            ESP_LOGE(RC522_TAG, "Failed to start scanner %u: %d", readers[i].id, err);
+            ret = err;
+        }
 
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+        if (i + 1 < READER_COUNT)
+            vTaskDelay(pdMS_TO_TICKS(RC522_SCAN_INTERVAL_MS / READER_COUNT));
+    }
 
-    green_off();
-    buzzer(0);
+    return ret;
 }
 
-void forb_seq() {
-    red_on();
-    for (int i = 0; i < 3; i++) {
-        buzzer(0.80);
-        
-        vTaskDelay(250 / portTICK_PERIOD_MS);
-
-        buzzer(0);
-
-        vTaskDelay(250 / portTICK_PERIOD_MS);
+static void acl_sync_line(const char* line, void* ctx) {
+    acl_sync_t* sync = ctx;
+    unsigned long version, expected;
+    int fields;
+
+    // the first line tells whether the rest is the whole list or the changes since our version,
+    // and how many lines follow
+    if (sync->kind == ACL_SYNC_NONE) {
+        if ((fields = sscanf(line, "snapshot %lu %lu", &version, &expected)) >= 1) {
+            sync->kind = ACL_SYNC_SNAPSHOT;
+            acl_store_snapshot_begin();
+        } else if ((fields = sscanf(line, "delta %lu %lu", &version, &expected)) >= 1) {
+            sync->kind = ACL_SYNC_DELTA;
+            sync->truncated = acl_store_delta_begin() != ESP_OK;
+        } else {
+            return;
+        }
+        sync->version = version;
+        sync->expected = fields == 2 ? (long)expected : -1;
+        return;
     }
-    red_off();
-}
 
-void turn_on_led(uint8_t led_gpio_pin) {
-    TaskHandle_t blink_led_task_handle = NULL;
-
-    xTaskCreate(blink_led_task, "led_task", 2048, (void *)led_gpio_pin, 5, &blink_led_task_handle);
-    configASSERT(blink_led_task_handle);
-
-    if (led_gpio_pin == PIN_RED_LED) 
-        red_led_task_handle = blink_led_task_handle;
-    
-    if (led_gpio_pin == PIN_GREEN_LED)
-        green_led_task_handle = blink_led_task_handle;
+    sync->lines++;
+
+    char op = sync->kind == ACL_SYNC_DELTA ? *line++ : '+';
+    char* end;
+    errno = 0;
+    uint64_t sn = strtoull(line, &end, 10);
+    if (errno != 0 || end == line || *end != '\0')
+        return;
+
+    esp_err_t ret = ESP_OK;
+    if (sync->kind == ACL_SYNC_SNAPSHOT)
+        ret = acl_store_snapshot_add(sn);
+    else if (op == '+')
+        ret = acl_store_delta_add(sn);
+    else if (op == '-')
+        ret = acl_store_delta_remove(sn);
+
+    sync->changes++;
+    if (ret != ESP_OK)
+        sync->truncated = true;
 }
 
-void turn_off_led(uint8_t led_gpio_pin) {
-    if (led_gpio_pin == PIN_RED_LED && red_led_task_handle != NULL)
-        vTaskDelete(red_led_task_handle);
-    
-    if  (led_gpio_pin == PIN_GREEN_LED && green_led_task_handle != NULL)
-        vTaskDelete(green_led_task_handle);
+void acl_sync_task(void* arg) {
+    char url[API_URL_MAX + 12];
+    bool need_snapshot = false;
+
+    while (1) {
+        acl_sync_t sync = { .kind = ACL_SYNC_NONE, .expected = -1 };
+        snprintf(url, sizeof(url), "%s%lu", api_access_changes_url,
+                 need_snapshot ? 0ul : (unsigned long)acl_store_version());
+
+        // nothing is committed unless the whole answer arrived, lookups keep the previous list
+        if (http_get_lines(url, acl_sync_line, &sync) != ESP_OK || sync.kind == ACL_SYNC_NONE) {
+            vTaskDelay(ACL_RETRY_PERIOD_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        if (sync.expected >= 0 && sync.lines != (size_t)sync.expected) {
+            ESP_LOGW(ACL_TAG, "Access list answer has %u of %ld lines, keeping version %lu",
+                     (unsigned)sync.lines, sync.expected, (unsigned long)acl_store_version());
+            vTaskDelay(ACL_RETRY_PERIOD_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        need_snapshot = false;
+        if (sync.kind == ACL_SYNC_SNAPSHOT) {
+            // a truncated list is kept without a version, so the next sync is a snapshot again
+            if (sync.truncated)
+                ESP_LOGW(ACL_TAG, "Access list larger than %d entries, keeping the first ones", ACL_STORE_CAPACITY);
+            acl_store_snapshot_commit(sync.truncated ? 0 : sync.version);
+            ESP_LOGI(ACL_TAG, "Access list synchronised (%u cards, version %lu)",
+                     (unsigned)acl_store_count(), (unsigned long)sync.version);
+        } else if (sync.truncated) {
+            ESP_LOGW(ACL_TAG, "Changes do not fit in %d entries, asking for the whole list", ACL_STORE_CAPACITY);
+            need_snapshot = true;
+            continue;
+        } else if (sync.version != acl_store_version()) {
+            acl_store_delta_commit(sync.version);
+            ESP_LOGI(ACL_TAG, "Access list updated to version %lu (%u changes, %u cards)",
+                     (unsigned long)sync.version, (unsigned)sync.changes, (unsigned)acl_store_count());
+        }
+
+        vTaskDelay(ACL_SYNC_PERIOD_MS / portTICK_PERIOD_MS);
+    }
 }
 
-void ledc_buzzer_init() {
-    // Configure the LEDC peripheral for PWM generation
-    ledc_timer_config_t ledc_timer = {
-        .duty_resolution = BUZZER_RESOLUTION,
-        .freq_hz = BUZZER_FREQ_HZ,
-        .speed_mode = LEDC_HIGH_SPEED_MODE,
-        .timer_num = LEDC_TIMER_0
-    };
-    ledc_timer_config(&ledc_timer);
-
-    ledc_channel_config_t ledc_channel = {
-        .channel = BUZZER_CHANNEL,
-        .duty = 0,
-        .gpio_num = PIN_BUZZER,
-        .speed_mode = LEDC_HIGH_SPEED_MODE,
-        .timer_sel = LEDC_TIMER_0
-    };
-    ledc_channel_config(&ledc_channel);
+void event_upload_task(void* arg) {
+    static event_queue_entry_t batch[EVENT_BATCH_SIZE];
+    static char post_data[32 + EVENT_BATCH_SIZE * 112];
+
+    while (1) {
+        if (event_queue_pending() == 0)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        wifi_wait_connected(portMAX_DELAY);
+
+        size_t count = event_queue_peek(batch, EVENT_BATCH_SIZE);
+        if (count == 0)
+            continue;
+
+        // {"reader":1,"events":[{"seq":1,"sn":"123","access":1,"reader":1,"age":1500},...]}, the event's reader
+        // and age are left out when unknown; the dashboard skips sequence numbers of this reader it already logged
+        int len = snprintf(post_data, sizeof(post_data), "{\"reader\":%u,\"events\":[", settings.readerId);
+        for (size_t i = 0; i < count; i++) {
+            len += snprintf(post_data + len, sizeof(post_data) - len, "%s{\"seq\":%" PRIu32 ",\"sn\":\"%" PRIu64 "\",\"access\":%d",
+                            i > 0 ? "," : "", batch[i].sequence, batch[i].serialNumber, batch[i].access);
+            if (batch[i].readerId != EVENT_QUEUE_READER_UNKNOWN)
+                len += snprintf(post_data + len, sizeof(post_data) - len, ",\"reader\":%u", batch[i].readerId);
+            if (batch[i].ageKnown)
+                len += snprintf(post_data + len, sizeof(post_data) - len, ",\"age\":%" PRIu32, batch[i].ageMs);
+            len += snprintf(post_data + len, sizeof(post_data) - len, "}");
+        }
+        snprintf(post_data + len, sizeof(post_data) - len, "]}");
+
+        if (http_post_request(api_log_batch_url, post_data, NULL, 0, EVENT_UPLOAD_TIMEOUT_MS) == HTTP_RESULT_OK) {
+            event_queue_ack(batch[count - 1].sequence);
+            ESP_LOGI(EVENT_TAG, "Uploaded %u events, %u still pending", (unsigned)count, (unsigned)event_queue_pending());
+        } else {
+            ESP_LOGW(EVENT_TAG, "Upload failed, %u events pending", (unsigned)event_queue_pending());
+            vTaskDelay(EVENT_UPLOAD_RETRY_MS / portTICK_PERIOD_MS);
+        }
+    }
 }
-
-void buzzer(float duty_cycle) {
-    uint32_t duty = (uint32_t)((1 << BUZZER_RESOLUTION) * duty_cycle);
-    ledc_set_duty(LEDC_HIGH_SPEED_MODE, BUZZER_CHANNEL, duty);
-    ledc_update_duty(LEDC_HIGH_SPEED_MODE, BUZZER_CHANNEL);
-}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "acl_store.h"
+#include "black_box.h"
+#include "event_queue.h"
+#include "feedback.h"
+#include "http_request.h"
+#include "scan_handlers.h"
+#include "scan_link.h"
+#include "scan_recent.h"
+
+static const char* TAG = "rc522";
+
+static const char* access_url = NULL;
+static TaskHandle_t upload_task = NULL;
+
+// boot to the first scan the dashboard answered, the time Wi-Fi and the server take to be usable
+static int64_t first_answer_us = 0;
+
+const scan_pipeline_handlers_t scan_handlers = {
+    .decide = scan_decide,
+    .actuate = scan_actuate,
+    .persist = scan_persist
+};
+
+void scan_handlers_init(const char* accessUrl)
+{
+    access_url = accessUrl;
+}
+
+void scan_handlers_set_upload_task(TaskHandle_t task)
+{
+    upload_task = task;
+}
+
+void scan_capture(uint8_t readerId, uint64_t serialNumber, int64_t capturedUs)
+{
+    // card still on the reader, the first scan already got its answer
+    bool access;
+    if (scan_recent_check(readerId, serialNumber, capturedUs, &access)) {
+        ESP_LOGD(TAG, "Repeated scan on reader %u (sn: %" PRIu64 ", %s)", readerId, serialNumber,
+                 access ? "granted" : "denied");
+        return;
+    }
+
+    // print the serial number as hexadecimal
+    ESP_LOG_BUFFER_HEX(TAG, &serialNumber, sizeof(serialNumber));
+
+    ESP_LOGI(TAG, "Tag scanned on reader %u (sn: %" PRIu64 ")", readerId, serialNumber);
+
+    // acknowledge the card unless an earlier one is still giving feedback, or is about to
+    feedback_play_if_idle(FEEDBACK_REQUEST_PENDING);
+
+    if (scan_pipeline_submit(readerId, serialNumber, capturedUs) != ESP_OK)
+        scan_recent_forget(readerId, serialNumber);
+}
+
+bool scan_decide(scan_t* scan)
+{
+    bool access = request_access(scan->readerId, scan->serialNumber, &scan->reported);
+    scan_recent_set_decision(scan->readerId, scan->serialNumber, access);
+
+    if (scan->reported && first_answer_us == 0) {
+        first_answer_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "First scan answered by the dashboard %lld ms after boot", (long long)(first_answer_us / 1000));
+    }
+    return access;
+}
+
+void scan_actuate(const scan_t* scan)
+{
+    feedback_play(scan->access ? FEEDBACK_GRANTED : FEEDBACK_DENIED);
+
+    // each card gets its full feedback, later ones wait in the actuate queue
+    feedback_wait_idle(portMAX_DELAY);
+}
+
+void scan_persist(const scan_t* scan)
+{
+    // append the access to the journal in the eeprom (black box)
+    black_box_record(scan->serialNumber, scan->access);
+
+    // accesses the dashboard has not logged yet are kept in flash until uploaded
+    if (!scan->reported && event_queue_push(scan->serialNumber, scan->access, scan->readerId) == ESP_OK && upload_task != NULL)
+        xTaskNotifyGive(upload_task);
+}
+
+bool request_access(uint8_t readerId, uint64_t serialNumber, bool* reported)
+{
+    *reported = false;
+
+    // cards on the local list are granted without waiting for the network,
+    // unknown cards still ask the dashboard in case the list is outdated
+    if (acl_store_contains(serialNumber)) {
+        ESP_LOGI(TAG, "Access granted (cached).");
+        return true;
+    }
+
+    // binary frame over udp first, json over http if the dashboard does not answer it
+    bool access;
+    int64_t start = esp_timer_get_time();
+    if (scan_link_request(readerId, serialNumber, &access, SCAN_LINK_TIMEOUT_MS) == ESP_OK) {
+        *reported = true;
+        ESP_LOGI(TAG, "Access %s (%lld us).", access ? "granted" : "denied", (long long)(esp_timer_get_time() - start));
+        return access;
+    }
+
+    char post_data[100];
+    snprintf(post_data, sizeof(post_data), "{\"sn\":\"%" PRIu64 "\",\"reader\":%u}", serialNumber, readerId);
+
+    char response[HTTP_RESPONSE_MAX];
+    start = esp_timer_get_time();
+    http_result_t result = http_post_request(access_url, post_data, response, sizeof(response), ACCESS_TIMEOUT_MS);
+    long long elapsed_ms = (esp_timer_get_time() - start) / 1000;
+
+    access = result == HTTP_RESULT_OK && response[0] == '1';
+    *reported = result == HTTP_RESULT_OK;
+
+    if (result == HTTP_RESULT_TIMEOUT)
+        ESP_LOGW(TAG, "Access request timed out after %lld ms, denying.", elapsed_ms);
+    else if (result == HTTP_RESULT_FAILED)
+        ESP_LOGW(TAG, "Access request failed after %lld ms, denying.", elapsed_ms);
+    else if (access)
+        ESP_LOGI(TAG, "Access granted (%lld ms).", elapsed_ms);
+    else
+        ESP_LOGI(TAG, "Access denied (%lld ms).", elapsed_ms);
+
+    return access;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "scan_pipeline.h"
+
+// What happens to a scan once a reader reports the card: repeats are filtered, the request
+// pattern is played and the scan enters the pipeline, whose stages decide it (local list,
+// then the dashboard over UDP or HTTP), play the decision and record it in the black box
+// and the event queue. Kept out of rfid.c so the host replay (esp32/host/scan_replay.c)
+// drives the same code as the firmware.
+
+#define ACCESS_TIMEOUT_MS 1500
+
+#define SCAN_LINK_TIMEOUT_MS 300
+
+// accessUrl is the /check_access url used when the UDP link does not answer, it is not copied
+void scan_handlers_init(const char* accessUrl);
+
+// Notified when a scan is queued for upload, NULL until the upload task runs
+void scan_handlers_set_upload_task(TaskHandle_t task);
+
+// Capture stage, called from the reader event handler
+void scan_capture(uint8_t readerId, uint64_t serialNumber, int64_t capturedUs);
+
+bool request_access(uint8_t readerId, uint64_t serialNumber, bool* reported);
+
+bool scan_decide(scan_t* scan);
+
+// Returns once the feedback is over
+void scan_actuate(const scan_t* scan);
+
+void scan_persist(const scan_t* scan);
+
+extern const scan_pipeline_handlers_t scan_handlers;
@@ -0,0 +1,176 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "scan_pipeline.h"
+#include "scan_trace.h"
+
+typedef struct {
+    QueueHandle_t queue;
+    StaticQueue_t buffer;
+    scan_stage_stats_t stats;
+} scan_stage_queue_t;
+
+static const char *TAG = "SCAN";
+
+static uint8_t decide_storage[SCAN_DECIDE_QUEUE_LENGTH * sizeof(scan_t)];
+static uint8_t actuate_storage[SCAN_ACTUATE_QUEUE_LENGTH * sizeof(scan_t)];
+static uint8_t persist_storage[SCAN_PERSIST_QUEUE_LENGTH * sizeof(scan_t)];
+
+static scan_stage_queue_t stages[SCAN_STAGE_COUNT];
+static scan_pipeline_handlers_t handlers;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t first_capture_us = 0;
+
+static void stage_enqueued(scan_stage_queue_t* stage)
+{
+    uint32_t depth = uxQueueMessagesWaiting(stage->queue);
+
+    taskENTER_CRITICAL(&stats_lock);
+    stage->stats.enqueued++;
+    if (depth > stage->stats.highWater)
+        stage->stats.highWater = depth;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+// Later stages block when the next queue is full, which backs the pressure up to the capture stage
+static void stage_forward(scan_stage_t next, const scan_t* scan)
+{
+    xQueueSend(stages[next].queue, scan, portMAX_DELAY);
+    stage_enqueued(&stages[next]);
+}
+
+static void stage_processed(scan_stage_queue_t* stage)
+{
+    taskENTER_CRITICAL(&stats_lock);
+    stage->stats.processed++;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+static void decide_task(void* arg)
+{
+    (void)arg;
+    scan_t scan;
+    while (1) {
+        xQueueReceive(stages[SCAN_STAGE_DECIDE].queue, &scan, portMAX_DELAY);
+        SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_DECIDE_START);
+        scan.access = handlers.decide(&scan);
+        SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_DECIDE_END);
+        stage_processed(&stages[SCAN_STAGE_DECIDE]);
+
+        stage_forward(SCAN_STAGE_ACTUATE, &scan);
+        stage_forward(SCAN_STAGE_PERSIST, &scan);
+    }
+}
+
+static void actuate_task(void* arg)
+{
+    (void)arg;
+    scan_t scan;
+    while (1) {
+        xQueueReceive(stages[SCAN_STAGE_ACTUATE].queue, &scan, portMAX_DELAY);
+        SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_ACTUATE_START);
+        handlers.actuate(&scan);
+        SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_ACTUATE_END);
+        stage_processed(&stages[SCAN_STAGE_ACTUATE]);
+    }
+}
+
+static void persist_task(void* arg)
+{
+    (void)arg;
+    scan_t scan;
+    while (1) {
+        xQueueReceive(stages[SCAN_STAGE_PERSIST].queue, &scan, portMAX_DELAY);
+        SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_PERSIST_START);
+        handlers.persist(&scan);
+        SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_PERSIST_END);
+        stage_processed(&stages[SCAN_STAGE_PERSIST]);
+
+        if (stages[SCAN_STAGE_PERSIST].stats.processed % SCAN_STATS_PERIOD == 0)
+            scan_pipeline_log_stats();
+    }
+}
+
+esp_err_t scan_pipeline_start(const scan_pipeline_handlers_t* pHandlers)
+{
+    handlers = *pHandlers;
+
+    stages[SCAN_STAGE_DECIDE].queue = xQueueCreateStatic(SCAN_DECIDE_QUEUE_LENGTH, sizeof(scan_t),
+                                                         decide_storage, &stages[SCAN_STAGE_DECIDE].buffer);
+    stages[SCAN_STAGE_ACTUATE].queue = xQueueCreateStatic(SCAN_ACTUATE_QUEUE_LENGTH, sizeof(scan_t),
+                                                          actuate_storage, &stages[SCAN_STAGE_ACTUATE].buffer);
+    stages[SCAN_STAGE_PERSIST].queue = xQueueCreateStatic(SCAN_PERSIST_QUEUE_LENGTH, sizeof(scan_t),
+                                                          persist_storage, &stages[SCAN_STAGE_PERSIST].buffer);
+
+    if (xTaskCreate(&decide_task, "scan_decide", 4096, NULL, 5, NULL) != pdPASS ||
+        xTaskCreate(&actuate_task, "scan_actuate", 2048, NULL, 5, NULL) != pdPASS ||
+        xTaskCreate(&persist_task, "scan_persist", 3072, NULL, 4, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the scan pipeline");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t scan_pipeline_submit(uint8_t readerId, uint64_t serialNumber, int64_t capturedUs)
+{
+    scan_t scan = {
+        .serialNumber = serialNumber,
+        .readerId = readerId,
+        .access = false,
+        .reported = false,
+        .capturedUs = capturedUs,
+        .traceId = SCAN_TRACE_BEGIN(capturedUs),
+    };
+
+    if (first_capture_us == 0)
+        first_capture_us = scan.capturedUs;
+
+    // stamped before sending, the decide task may run before xQueueSend returns
+    SCAN_TRACE_STAMP(scan.traceId, SCAN_TRACE_QUEUED);
+
+    scan_stage_queue_t* stage = &stages[SCAN_STAGE_DECIDE];
+    if (xQueueSend(stage->queue, &scan, 0) != pdTRUE) {
+        taskENTER_CRITICAL(&stats_lock);
+        stage->stats.dropped++;
+        taskEXIT_CRITICAL(&stats_lock);
+        ESP_LOGW(TAG, "Decide queue full, scan dropped");
+        return ESP_ERR_NO_MEM;
+    }
+
+    stage_enqueued(stage);
+    return ESP_OK;
+}
+
+void scan_pipeline_get_stats(scan_stage_stats_t stats[SCAN_STAGE_COUNT])
+{
+    taskENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < SCAN_STAGE_COUNT; i++)
+        stats[i] = stages[i].stats;
+    taskEXIT_CRITICAL(&stats_lock);
+
+    for (int i = 0; i < SCAN_STAGE_COUNT; i++)
+        stats[i].depth = uxQueueMessagesWaiting(stages[i].queue);
+}
+
+void scan_pipeline_log_stats(void)
+{
+    static const char* names[SCAN_STAGE_COUNT] = { "decide", "actuate", "persist" };
+    scan_stage_stats_t stats[SCAN_STAGE_COUNT];
+    scan_pipeline_get_stats(stats);
+
+    for (int i = 0; i < SCAN_STAGE_COUNT; i++)
+        ESP_LOGI(TAG, "%-8s enqueued %lu, dropped %lu, processed %lu, depth %lu, high water %lu", names[i],
+                 (unsigned long)stats[i].enqueued, (unsigned long)stats[i].dropped, (unsigned long)stats[i].processed,
+                 (unsigned long)stats[i].depth, (unsigned long)stats[i].highWater);
+
+    int64_t elapsed_us = esp_timer_get_time() - first_capture_us;
+    if (first_capture_us != 0 && elapsed_us > 0)
+        ESP_LOGI(TAG, "Throughput: %.1f cards/min",
+                 stats[SCAN_STAGE_PERSIST].processed * 60e6 / (double)elapsed_us);
+
+    scan_trace_log();
+}
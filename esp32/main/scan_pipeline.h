@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Scans go through capture -> decide -> actuate / persist, each stage in its own
+// task and linked by bounded queues, so a card beeping does not hold the reader
+
+typedef struct {
+    uint64_t serialNumber;
+    uint8_t readerId;
+    bool access;
+    bool reported;           // the dashboard already logged the decision
+    int64_t capturedUs;
+    uint32_t traceId;
+} scan_t;
+
+typedef struct {
+    bool (*decide)(scan_t* scan);            // returns the access decision
+    void (*actuate)(const scan_t* scan);     // returns once the feedback is over
+    void (*persist)(const scan_t* scan);
+} scan_pipeline_handlers_t;
+
+typedef enum {
+    SCAN_STAGE_DECIDE,
+    SCAN_STAGE_ACTUATE,
+    SCAN_STAGE_PERSIST,
+    SCAN_STAGE_COUNT
+} scan_stage_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t dropped;        // queue full, only the capture stage drops
+    uint32_t processed;
+    uint32_t depth;
+    uint32_t highWater;
+} scan_stage_stats_t;
+
+#define SCAN_DECIDE_QUEUE_LENGTH 8
+#define SCAN_ACTUATE_QUEUE_LENGTH 4
+#define SCAN_PERSIST_QUEUE_LENGTH 8
+
+// Stage counters are logged every this many persisted scans
+#define SCAN_STATS_PERIOD 16
+
+esp_err_t scan_pipeline_start(const scan_pipeline_handlers_t* handlers);
+
+// Capture stage, never blocks: the scan is dropped (and counted) when the decide queue is full.
+// capturedUs is when the reader reported the card.
+esp_err_t scan_pipeline_submit(uint8_t readerId, uint64_t serialNumber, int64_t capturedUs);
+
+void scan_pipeline_get_stats(scan_stage_stats_t stats[SCAN_STAGE_COUNT]);
+
+void scan_pipeline_log_stats(void);
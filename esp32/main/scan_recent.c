@@ -0,0 +1,101 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "scan_recent.h"
+
+typedef struct {
+    uint64_t serialNumber;           // 0 for a free entry
+    uint8_t readerId;
+    int64_t firstSeenUs;
+    int64_t lastSeenUs;
+    uint32_t repeats;
+    bool decided;
+    bool access;
+} recent_entry_t;
+
+static const char *TAG = "RECENT";
+
+static recent_entry_t entries[SCAN_RECENT_SIZE];
+static int64_t window_us;
+static scan_recent_stats_t stats;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+void scan_recent_init(uint32_t windowMs)
+{
+    window_us = (int64_t)windowMs * 1000;
+}
+
+static void log_presentation(const recent_entry_t* entry)
+{
+    if (entry->serialNumber != 0 && entry->repeats > 0)
+        ESP_LOGI(TAG, "Card %llu held on reader %u for %lld ms, %lu repeated scans suppressed",
+                 (unsigned long long)entry->serialNumber, entry->readerId, (long long)((entry->lastSeenUs - entry->firstSeenUs) / 1000),
+                 (unsigned long)entry->repeats);
+}
+
+bool scan_recent_check(uint8_t readerId, uint64_t serialNumber, int64_t nowUs, bool* pAccess)
+{
+    recent_entry_t* found = NULL;
+    recent_entry_t* oldest = &entries[0];
+
+    taskENTER_CRITICAL(&lock);
+    for (int i = 0; i < SCAN_RECENT_SIZE; i++) {
+        if (entries[i].serialNumber == serialNumber && entries[i].readerId == readerId)
+            found = &entries[i];
+        if (entries[i].lastSeenUs < oldest->lastSeenUs)
+            oldest = &entries[i];
+    }
+
+    if (found != NULL && nowUs - found->lastSeenUs <= window_us) {
+        found->lastSeenUs = nowUs;
+        found->repeats++;
+        stats.repeats++;
+        *pAccess = found->decided && found->access;
+        taskEXIT_CRITICAL(&lock);
+        return true;
+    }
+
+    // a new presentation takes its own old entry or the least recently seen one
+    recent_entry_t* entry = found != NULL ? found : oldest;
+    recent_entry_t previous = *entry;
+    *entry = (recent_entry_t) {
+        .serialNumber = serialNumber,
+        .readerId = readerId,
+        .firstSeenUs = nowUs,
+        .lastSeenUs = nowUs,
+    };
+    stats.presentations++;
+    taskEXIT_CRITICAL(&lock);
+
+    log_presentation(&previous);
+    return false;
+}
+
+void scan_recent_set_decision(uint8_t readerId, uint64_t serialNumber, bool access)
+{
+    taskENTER_CRITICAL(&lock);
+    for (int i = 0; i < SCAN_RECENT_SIZE; i++) {
+        if (entries[i].serialNumber == serialNumber && entries[i].readerId == readerId) {
+            entries[i].decided = true;
+            entries[i].access = access;
+        }
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+void scan_recent_forget(uint8_t readerId, uint64_t serialNumber)
+{
+    taskENTER_CRITICAL(&lock);
+    for (int i = 0; i < SCAN_RECENT_SIZE; i++) {
+        if (entries[i].serialNumber == serialNumber && entries[i].readerId == readerId)
+            entries[i] = (recent_entry_t) { 0 };
+    }
+    taskEXIT_CRITICAL(&lock);
+}
+
+scan_recent_stats_t scan_recent_get_stats(void)
+{
+    taskENTER_CRITICAL(&lock);
+    scan_recent_stats_t copy = stats;
+    taskEXIT_CRITICAL(&lock);
+    return copy;
+}
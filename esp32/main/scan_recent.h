@@ -0,0 +1,29 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Recently presented cards, so a card held on a reader is handled once. Each reader has its
+// own presentations, the same card on the entry and then the exit reader is scanned twice. A scan of a card
+// seen less than the window ago (measured from its last scan, so holding it keeps it
+// suppressed) is a repeat: it is only counted, and one line with the count is logged when
+// its entry is taken by a later presentation. Repeats keep the decision of the first scan.
+
+#define SCAN_RECENT_SIZE 8
+
+typedef struct {
+    uint32_t presentations;
+    uint32_t repeats;
+} scan_recent_stats_t;
+
+void scan_recent_init(uint32_t windowMs);
+
+// True when the scan repeats a presentation still in the window and must be dropped,
+// pAccess is then the decision of that presentation (false while it is being decided)
+bool scan_recent_check(uint8_t readerId, uint64_t serialNumber, int64_t nowUs, bool* pAccess);
+
+void scan_recent_set_decision(uint8_t readerId, uint64_t serialNumber, bool access);
+
+// Forgets a presentation that was not processed (e.g. dropped), so the next scan goes through
+void scan_recent_forget(uint8_t readerId, uint64_t serialNumber);
+
+scan_recent_stats_t scan_recent_get_stats(void);
@@ -0,0 +1,220 @@
+#include "scan_trace.h"
+
+#if SCAN_TRACE_ENABLED
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+
+typedef struct {
+    uint32_t id;                     // 0 while the slot is being reset
+    uint32_t remaining;              // of actuate end and persist end
+    int64_t stamps[SCAN_TRACE_STAGE_COUNT];
+} trace_slot_t;
+
+typedef struct {
+    uint32_t buckets[SCAN_TRACE_BUCKETS];
+    uint32_t count;
+    uint32_t maxUs;
+    uint64_t sumUs;
+} trace_histogram_t;
+
+static const char *TAG = "TRACE";
+
+static const char* interval_names[SCAN_TRACE_INTERVAL_COUNT] = {
+    "capture", "decide_wait", "decide", "actuate_wait", "actuate", "persist_wait", "persist", "decision", "total"
+};
+
+// start and end stage of each interval, total ends at the later of actuate and persist
+static const scan_trace_stage_t interval_stages[SCAN_TRACE_INTERVAL_COUNT][2] = {
+    { SCAN_TRACE_DETECTED, SCAN_TRACE_QUEUED },
+    { SCAN_TRACE_QUEUED, SCAN_TRACE_DECIDE_START },
+    { SCAN_TRACE_DECIDE_START, SCAN_TRACE_DECIDE_END },
+    { SCAN_TRACE_DECIDE_END, SCAN_TRACE_ACTUATE_START },
+    { SCAN_TRACE_ACTUATE_START, SCAN_TRACE_ACTUATE_END },
+    { SCAN_TRACE_DECIDE_END, SCAN_TRACE_PERSIST_START },
+    { SCAN_TRACE_PERSIST_START, SCAN_TRACE_PERSIST_END },
+    { SCAN_TRACE_DETECTED, SCAN_TRACE_DECIDE_END },
+    { SCAN_TRACE_DETECTED, SCAN_TRACE_ACTUATE_END },
+};
+
+static trace_slot_t ring[SCAN_TRACE_SLOTS];
+static uint32_t next_id = 0;
+static uint32_t completed = 0;
+static trace_histogram_t histograms[2][SCAN_TRACE_INTERVAL_COUNT];
+
+uint32_t scan_trace_begin(int64_t detectedUs)
+{
+    uint32_t id = __atomic_add_fetch(&next_id, 1, __ATOMIC_RELAXED);
+    if (id == 0)
+        id = __atomic_add_fetch(&next_id, 1, __ATOMIC_RELAXED);
+
+    trace_slot_t* slot = &ring[id % SCAN_TRACE_SLOTS];
+    __atomic_store_n(&slot->id, 0, __ATOMIC_RELEASE);
+    memset(slot->stamps, 0, sizeof(slot->stamps));
+    slot->stamps[SCAN_TRACE_DETECTED] = detectedUs;
+    slot->remaining = 2;
+    __atomic_store_n(&slot->id, id, __ATOMIC_RELEASE);
+
+    return id;
+}
+
+static uint32_t bucket_of(uint32_t us)
+{
+    uint32_t bucket = 31 - __builtin_clz(us | 1);
+    return bucket < SCAN_TRACE_BUCKETS ? bucket : SCAN_TRACE_BUCKETS - 1;
+}
+
+static void trace_finish(trace_slot_t* slot, uint32_t id)
+{
+    int64_t stamps[SCAN_TRACE_STAGE_COUNT];
+    memcpy(stamps, slot->stamps, sizeof(stamps));
+
+    // the ring wrapped around while this scan was in flight
+    if (__atomic_load_n(&slot->id, __ATOMIC_ACQUIRE) != id)
+        return;
+
+    if (stamps[SCAN_TRACE_PERSIST_END] > stamps[SCAN_TRACE_ACTUATE_END])
+        stamps[SCAN_TRACE_ACTUATE_END] = stamps[SCAN_TRACE_PERSIST_END];
+
+    // a new window starts by clearing the older generation
+    uint32_t n = __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED) - 1;
+    trace_histogram_t* generation = histograms[(n / SCAN_TRACE_WINDOW) % 2];
+    if (n % SCAN_TRACE_WINDOW == 0)
+        memset(generation, 0, sizeof(histograms[0]));
+
+    for (int i = 0; i < SCAN_TRACE_INTERVAL_COUNT; i++) {
+        int64_t start = stamps[interval_stages[i][0]];
+        int64_t end = stamps[interval_stages[i][1]];
+        if (start == 0 || end < start)
+            continue;
+
+        uint32_t us = end - start > UINT32_MAX ? UINT32_MAX : (uint32_t)(end - start);
+        trace_histogram_t* h = &generation[i];
+        __atomic_add_fetch(&h->buckets[bucket_of(us)], 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&h->sumUs, us, __ATOMIC_RELAXED);
+
+        uint32_t max = __atomic_load_n(&h->maxUs, __ATOMIC_RELAXED);
+        while (us > max && !__atomic_compare_exchange_n(&h->maxUs, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ;
+    }
+}
+
+void scan_trace_stamp(uint32_t id, scan_trace_stage_t stage)
+{
+    trace_slot_t* slot = &ring[id % SCAN_TRACE_SLOTS];
+    if (id == 0 || __atomic_load_n(&slot->id, __ATOMIC_ACQUIRE) != id)
+        return;
+
+    slot->stamps[stage] = esp_timer_get_time();
+
+    // actuate and persist run in parallel, whichever ends last closes the trace
+    if ((stage == SCAN_TRACE_ACTUATE_END || stage == SCAN_TRACE_PERSIST_END) &&
+        __atomic_sub_fetch(&slot->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+        trace_finish(slot, id);
+}
+
+static uint32_t percentile(const uint32_t buckets[SCAN_TRACE_BUCKETS], uint32_t count, uint32_t permille)
+{
+    uint32_t rank = (count * permille + 999) / 1000;
+    uint32_t seen = 0;
+    for (int i = 0; i < SCAN_TRACE_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank && seen > 0)
+            return (2u << i) - 1;
+    }
+    return 0;
+}
+
+void scan_trace_get(scan_trace_summary_t summary[SCAN_TRACE_INTERVAL_COUNT])
+{
+    for (int i = 0; i < SCAN_TRACE_INTERVAL_COUNT; i++) {
+        uint32_t buckets[SCAN_TRACE_BUCKETS];
+        uint64_t sum = 0;
+        uint32_t count = 0, max = 0;
+
+        for (int g = 0; g < 2; g++) {
+            const trace_histogram_t* h = &histograms[g][i];
+            for (int b = 0; b < SCAN_TRACE_BUCKETS; b++)
+                buckets[b] = (g == 0 ? 0 : buckets[b]) + h->buckets[b];
+            count += h->count;
+            sum += h->sumUs;
+            if (h->maxUs > max)
+                max = h->maxUs;
+        }
+
+        summary[i] = (scan_trace_summary_t) {
+            .count = count,
+            .p50Us = percentile(buckets, count, 500),
+            .p90Us = percentile(buckets, count, 900),
+            .p99Us = percentile(buckets, count, 990),
+            .maxUs = max,
+            .meanUs = count > 0 ? (uint32_t)(sum / count) : 0,
+        };
+    }
+}
+
+void scan_trace_log(void)
+{
+    scan_trace_summary_t summary[SCAN_TRACE_INTERVAL_COUNT];
+    scan_trace_get(summary);
+
+    for (int i = 0; i < SCAN_TRACE_INTERVAL_COUNT; i++)
+        ESP_LOGI(TAG, "%-12s n %3lu, mean %7lu us, p50 < %7lu us, p90 < %7lu us, p99 < %7lu us, max %7lu us",
+                 interval_names[i], (unsigned long)summary[i].count, (unsigned long)summary[i].meanUs,
+                 (unsigned long)summary[i].p50Us, (unsigned long)summary[i].p90Us, (unsigned long)summary[i].p99Us,
+                 (unsigned long)summary[i].maxUs);
+}
+
+size_t scan_trace_format_json(char* buffer, size_t size)
+{
+    scan_trace_summary_t summary[SCAN_TRACE_INTERVAL_COUNT];
+    scan_trace_get(summary);
+
+    size_t len = snprintf(buffer, size, "{\"scans\":%lu", (unsigned long)__atomic_load_n(&completed, __ATOMIC_RELAXED));
+    for (int i = 0; i < SCAN_TRACE_INTERVAL_COUNT && len < size; i++)
+        len += snprintf(buffer + len, size - len,
+                        ",\"%s\":{\"count\":%lu,\"mean_us\":%lu,\"p50_us\":%lu,\"p90_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu}",
+                        interval_names[i], (unsigned long)summary[i].count, (unsigned long)summary[i].meanUs,
+                        (unsigned long)summary[i].p50Us, (unsigned long)summary[i].p90Us,
+                        (unsigned long)summary[i].p99Us, (unsigned long)summary[i].maxUs);
+    if (len < size)
+        len += snprintf(buffer + len, size - len, "}");
+
+    return len < size ? len : size - 1;
+}
+
+static esp_err_t trace_get_handler(httpd_req_t* req)
+{
+    static char json[SCAN_TRACE_INTERVAL_COUNT * 128 + 32];
+    size_t len = scan_trace_format_json(json, sizeof(json));
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, json, len);
+}
+
+esp_err_t scan_trace_http_start(void)
+{
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.stack_size = 3072;
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the trace server: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    httpd_uri_t trace_uri = {
+        .uri = "/trace",
+        .method = HTTP_GET,
+        .handler = trace_get_handler,
+    };
+    return httpd_register_uri_handler(server, &trace_uri);
+}
+
+#endif
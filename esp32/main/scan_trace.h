@@ -0,0 +1,83 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// Per-scan latency tracing: every scan gets a monotonic id and each pipeline stage stamps it
+// with esp_timer_get_time() into a lock-free ring. Once a scan is both actuated and persisted
+// its intervals go into rolling log2 histograms, shown on the console with the pipeline stats
+// and as JSON on GET /trace. Turned off with CONFIG_SCAN_TRACE_ENABLED (menuconfig, "Access
+// reader"), or SCAN_TRACE_ENABLED=0 on the command line, to compile it out.
+//
+// The RC522 library polls the card in its own task, so the time from the card entering the
+// field to the scanned event is not visible here; "detected" is when the event is handled.
+
+#ifndef SCAN_TRACE_ENABLED
+#ifdef CONFIG_SCAN_TRACE_ENABLED
+#define SCAN_TRACE_ENABLED 1
+#else
+#define SCAN_TRACE_ENABLED 0
+#endif
+#endif
+
+#define SCAN_TRACE_SLOTS 32          // scans in flight that can be traced at once
+#define SCAN_TRACE_BUCKETS 24        // log2 buckets of microseconds, up to ~16 s
+#define SCAN_TRACE_WINDOW 64         // histograms cover the last one to two windows of scans
+
+typedef enum {
+    SCAN_TRACE_DETECTED,
+    SCAN_TRACE_QUEUED,
+    SCAN_TRACE_DECIDE_START,
+    SCAN_TRACE_DECIDE_END,
+    SCAN_TRACE_ACTUATE_START,
+    SCAN_TRACE_ACTUATE_END,
+    SCAN_TRACE_PERSIST_START,
+    SCAN_TRACE_PERSIST_END,
+    SCAN_TRACE_STAGE_COUNT
+} scan_trace_stage_t;
+
+typedef enum {
+    SCAN_TRACE_CAPTURE,              // detected -> queued (logging, pending feedback)
+    SCAN_TRACE_DECIDE_WAIT,
+    SCAN_TRACE_DECIDE,               // cache lookup or network round trip
+    SCAN_TRACE_ACTUATE_WAIT,
+    SCAN_TRACE_ACTUATE,              // leds and buzzer
+    SCAN_TRACE_PERSIST_WAIT,
+    SCAN_TRACE_PERSIST,              // eeprom journal and event queue
+    SCAN_TRACE_DECISION,             // detected -> decision taken
+    SCAN_TRACE_TOTAL,                // detected -> actuated and persisted
+    SCAN_TRACE_INTERVAL_COUNT
+} scan_trace_interval_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50Us;                  // percentiles are bucket upper bounds
+    uint32_t p90Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+    uint32_t meanUs;
+} scan_trace_summary_t;
+
+#if SCAN_TRACE_ENABLED
+
+uint32_t scan_trace_begin(int64_t detectedUs);
+void scan_trace_stamp(uint32_t id, scan_trace_stage_t stage);
+
+void scan_trace_get(scan_trace_summary_t summary[SCAN_TRACE_INTERVAL_COUNT]);
+void scan_trace_log(void);
+size_t scan_trace_format_json(char* buffer, size_t size);
+esp_err_t scan_trace_http_start(void);
+
+#define SCAN_TRACE_BEGIN(detectedUs) scan_trace_begin(detectedUs)
+#define SCAN_TRACE_STAMP(id, stage) scan_trace_stamp((id), (stage))
+
+#else
+
+static inline void scan_trace_log(void) {}
+static inline esp_err_t scan_trace_http_start(void) { return ESP_OK; }
+
+#define SCAN_TRACE_BEGIN(detectedUs) 0
+#define SCAN_TRACE_STAMP(id, stage) ((void)(id))
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "settings.h"
+
+static const char* TAG = "settings";
+
+static void load_string(nvs_handle_t handle, const char* key, char* value, size_t size, bool* pMissing)
+{
+    size_t length = size;
+    if (nvs_get_str(handle, key, value, &length) != ESP_OK)
+        *pMissing = true;
+}
+
+esp_err_t settings_load(settings_t* pSettings)
+{
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open the settings: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // a value that does not fit or is missing keeps its default
+    settings_t stored = *pSettings;
+    bool missing = false;
+    load_string(handle, "server_ip", stored.serverIp, sizeof(stored.serverIp), &missing);
+    load_string(handle, "static_ip", stored.staticIp, sizeof(stored.staticIp), &missing);
+    load_string(handle, "gateway", stored.gateway, sizeof(stored.gateway), &missing);
+    load_string(handle, "netmask", stored.netmask, sizeof(stored.netmask), &missing);
+    if (nvs_get_u8(handle, "reader_id", &stored.readerId) != ESP_OK)
+        missing = true;
+    nvs_close(handle);
+
+    *pSettings = stored;
+
+    ESP_LOGI(TAG, "Server %s, reader id %u, %s%s", pSettings->serverIp, pSettings->readerId,
+             pSettings->staticIp[0] ? "static ip " : "dhcp", pSettings->staticIp);
+
+    return missing ? settings_save(pSettings) : ESP_OK;
+}
+
+esp_err_t settings_save(const settings_t* pSettings)
+{
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK)
+        return ret;
+
+    ret = nvs_set_str(handle, "server_ip", pSettings->serverIp);
+    if (ret == ESP_OK)
+        ret = nvs_set_str(handle, "static_ip", pSettings->staticIp);
+    if (ret == ESP_OK)
+        ret = nvs_set_str(handle, "gateway", pSettings->gateway);
+    if (ret == ESP_OK)
+        ret = nvs_set_str(handle, "netmask", pSettings->netmask);
+    if (ret == ESP_OK)
+        ret = nvs_set_u8(handle, "reader_id", pSettings->readerId);
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "Failed to store the settings: %s", esp_err_to_name(ret));
+    return ret;
+}
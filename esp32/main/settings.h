@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+// Reader settings kept in NVS (namespace "reader"), so a device can be moved to another
+// server, reader id or address without rebuilding the firmware. Missing keys keep the
+// defaults passed in, which are stored on the first boot so they show up in the NVS.
+
+#define SETTINGS_NAMESPACE "reader"
+#define SETTINGS_IP_MAX 16
+
+typedef struct {
+    char serverIp[SETTINGS_IP_MAX];
+    uint8_t readerId;                  // id of the first reader, the others follow
+    char staticIp[SETTINGS_IP_MAX];    // empty for DHCP
+    char gateway[SETTINGS_IP_MAX];
+    char netmask[SETTINGS_IP_MAX];
+} settings_t;
+
+// NVS must be initialised
+esp_err_t settings_load(settings_t* pSettings);
+
+esp_err_t settings_save(const settings_t* pSettings);
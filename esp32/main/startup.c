@@ -0,0 +1,115 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "startup.h"
+
+#define STEP_TASK_PRIORITY 5
+
+typedef struct {
+    const startup_step_t* step;
+    int64_t queuedUs;
+    int64_t startUs;
+    int64_t readyUs;          // 0 while running
+    esp_err_t err;
+    bool degraded;            // started without any of requiresAny
+} step_record_t;
+
+static const char* TAG = "startup";
+
+static StaticEventGroup_t ready_buffer;
+static EventGroupHandle_t ready = NULL;
+static step_record_t records[STARTUP_MAX_STEPS];
+static int64_t deadline_us;
+
+static void step_task(void* arg)
+{
+    step_record_t* record = arg;
+    const startup_step_t* step = record->step;
+
+    if (step->requiresAll != 0)
+        xEventGroupWaitBits(ready, step->requiresAll, pdFALSE, pdTRUE, portMAX_DELAY);
+    if (step->requiresAny != 0) {
+        int64_t left_us = deadline_us - esp_timer_get_time();
+        TickType_t timeout = left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) : 0;
+        if (!(xEventGroupWaitBits(ready, step->requiresAny, pdFALSE, pdFALSE, timeout) & step->requiresAny)) {
+            record->degraded = true;
+            ESP_LOGW(TAG, "%s starts without its prerequisites", step->name);
+        }
+    }
+
+    record->startUs = esp_timer_get_time();
+    record->err = step->start();
+    record->readyUs = esp_timer_get_time();
+
+    if (record->readyUs > deadline_us)
+        ESP_LOGW(TAG, "%s ready %lld ms after boot, over the budget", step->name, record->readyUs / 1000);
+    xEventGroupSetBits(ready, step->bit);
+    vTaskDelete(NULL);
+}
+
+static void report(size_t count, uint32_t budgetMs)
+{
+    int64_t last_us = 0;
+
+    ESP_LOGI(TAG, "%-14s %8s %8s %8s", "step", "wait ms", "run ms", "ready ms");
+    for (size_t i = 0; i < count; i++) {
+        const step_record_t* record = &records[i];
+        if (record->readyUs == 0) {
+            ESP_LOGW(TAG, "%-14s not ready", record->step->name);
+            continue;
+        }
+        if (record->readyUs > last_us)
+            last_us = record->readyUs;
+        ESP_LOGI(TAG, "%-14s %8lld %8lld %8lld%s%s%s", record->step->name,
+                 (record->startUs - record->queuedUs) / 1000, (record->readyUs - record->startUs) / 1000,
+                 record->readyUs / 1000, record->degraded ? " degraded" : "",
+                 record->err != ESP_OK ? " " : "", record->err != ESP_OK ? esp_err_to_name(record->err) : "");
+    }
+
+    if (last_us > 0 && last_us <= deadline_us)
+        ESP_LOGI(TAG, "Started in %lld ms (budget %lu ms)", last_us / 1000, (unsigned long)budgetMs);
+    else
+        ESP_LOGW(TAG, "Not started within the budget of %lu ms", (unsigned long)budgetMs);
+}
+
+void startup_run(const startup_step_t* pSteps, size_t count, uint32_t budgetMs)
+{
+    if (count > STARTUP_MAX_STEPS)
+        count = STARTUP_MAX_STEPS;
+
+    // the budget counts from boot, esp_timer starts before app_main (only the bootloader is missing)
+    ready = xEventGroupCreateStatic(&ready_buffer);
+    deadline_us = (int64_t)budgetMs * 1000;
+
+    EventBits_t all = 0;
+    for (size_t i = 0; i < count; i++) {
+        records[i] = (step_record_t) { .step = &pSteps[i], .queuedUs = esp_timer_get_time() };
+        all |= pSteps[i].bit;
+
+        if (xTaskCreate(step_task, pSteps[i].name, pSteps[i].stackSize, &records[i], STEP_TASK_PRIORITY, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start %s", pSteps[i].name);
+            records[i].err = ESP_ERR_NO_MEM;
+            records[i].startUs = records[i].readyUs = esp_timer_get_time();
+            xEventGroupSetBits(ready, pSteps[i].bit);
+        }
+    }
+
+    int64_t left_us = deadline_us - esp_timer_get_time();
+    xEventGroupWaitBits(ready, all, pdFALSE, pdTRUE, left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) : 0);
+    report(count, budgetMs);
+}
+
+void startup_set_ready(EventBits_t bits)
+{
+    if (ready != NULL)
+        xEventGroupSetBits(ready, bits);
+}
+
+bool startup_wait(EventBits_t bits, TickType_t timeout)
+{
+    if (ready == NULL)
+        return false;
+    return (xEventGroupWaitBits(ready, bits, pdFALSE, pdTRUE, timeout) & bits) == bits;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_err.h"
+
+// Startup steps run in their own tasks as soon as what they need is ready, so slow ones
+// (Wi-Fi association) overlap the rest instead of delaying it. Each step has a readiness
+// bit in one event group, set when it is over, even if it failed (the error is reported),
+// so the steps after it behave like before and run without that subsystem.
+
+#define STARTUP_MAX_STEPS 16
+
+typedef struct {
+    const char* name;
+    EventBits_t bit;
+    EventBits_t requiresAll;
+    EventBits_t requiresAny;     // waited for up to the budget, the step then starts without them
+    esp_err_t (*start)(void);
+    uint32_t stackSize;
+} startup_step_t;
+
+// Starts every step and returns once all are done or the budget is over, after logging
+// when each one waited, ran and was ready. Steps still running report themselves when done.
+void startup_run(const startup_step_t* pSteps, size_t count, uint32_t budgetMs);
+
+// For readiness that is not the end of a step (e.g. a list found in flash)
+void startup_set_ready(EventBits_t bits);
+
+bool startup_wait(EventBits_t bits, TickType_t timeout);